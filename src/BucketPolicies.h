@@ -0,0 +1,133 @@
+//
+//  BucketPolicies.h
+//
+//  This file defines the policies HashTable uses to turn a hash into
+//  a bucket index. A policy rounds a requested number of array slots
+//  to one it supports and is rebuilt every time the table resizes, so
+//  any per-size precomputation happens once per resize instead of on
+//  every lookup.
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef bucketpolicies_hpp
+#define bucketpolicies_hpp
+
+#include <cstddef>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h> // __umulh()
+#endif
+
+namespace csi281 {
+    // 64-bit finalizer from MurmurHash3; spreads weak hashes such as
+    // the identity std::hash<int> across all of the output bits
+    inline size_t mixHash(size_t hashKey) {
+        uint64_t mixed = (uint64_t) hashKey;
+        mixed ^= mixed >> 33;
+        mixed *= 0xff51afd7ed558ccdULL;
+        mixed ^= mixed >> 33;
+        mixed *= 0xc4ceb9fe1a85ec53ULL;
+        mixed ^= mixed >> 33;
+        return (size_t) mixed;
+    }
+
+    // hash % slots; keeps the requested number of array slots exactly
+    class ModuloBuckets {
+    public:
+        static size_t roundSlots(size_t requested) { return requested; }
+
+        explicit ModuloBuckets(size_t slots = 1) : slots(slots) {}
+
+        size_t index(size_t hashKey) const { return hashKey % slots; }
+
+    private:
+        size_t slots;
+    };
+
+    // rounds array slots up to a power of two and masks the mixed hash
+    class PowerOfTwoBuckets {
+    public:
+        static size_t roundSlots(size_t requested) {
+            size_t rounded = 1;
+            while (rounded < requested)
+                rounded <<= 1;
+            return rounded;
+        }
+
+        explicit PowerOfTwoBuckets(size_t slots = 1) : mask(slots - 1) {}
+
+        size_t index(size_t hashKey) const { return mixHash(hashKey) & mask; }
+
+    private:
+        size_t mask;
+    };
+
+    // rounds array slots up to a prime and replaces hash % slots with
+    // Lemire's fastmod: one multiply by a magic number computed when
+    // the table resizes, then the high half of a second multiply.
+    // Works on the hash folded to 32 bits, so slots must fit in 32 bits.
+    class FastModBuckets {
+    public:
+        static size_t roundSlots(size_t requested) {
+            size_t candidate = requested < 2 ? 2 : requested;
+            while (!isPrime(candidate))
+                candidate++;
+            return candidate;
+        }
+
+        explicit FastModBuckets(size_t slots = 1)
+            : divisor((uint32_t) slots), magic(UINT64_MAX / divisor + 1) {}
+
+        size_t index(size_t hashKey) const {
+            uint32_t folded = (uint32_t) (((uint64_t) hashKey) ^ (((uint64_t) hashKey) >> 32));
+            uint64_t lowBits = magic * folded;
+            return (size_t) multiplyHigh(lowBits, divisor);
+        }
+
+    private:
+        uint32_t divisor;
+        uint64_t magic;
+
+        static bool isPrime(size_t candidate) {
+            if (candidate < 4)
+                return candidate >= 2;
+            if (candidate % 2 == 0)
+                return false;
+            for (size_t factor = 3; factor * factor <= candidate; factor += 2) {
+                if (candidate % factor == 0)
+                    return false;
+            }
+            return true;
+        }
+
+        static uint64_t multiplyHigh(uint64_t lhs, uint64_t rhs) {
+#ifdef _MSC_VER
+            return __umulh(lhs, rhs);
+#else
+            __extension__ typedef unsigned __int128 uint128;
+            return (uint64_t) (((uint128) lhs * rhs) >> 64);
+#endif
+        }
+    };
+}
+
+#endif /* bucketpolicies_hpp */
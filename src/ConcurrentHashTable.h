@@ -0,0 +1,151 @@
+//
+//  ConcurrentHashTable.h
+//
+//  This file defines a thread-safe Hash Table built from independent
+//  HashTable shards. The high bits of a key's hash pick its shard and
+//  every shard has its own reader-writer lock, so operations on
+//  different shards run in parallel and lookups on the same shard only
+//  share a lock.
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef concurrenthashtable_hpp
+#define concurrenthashtable_hpp
+
+#include <memory> // unique_ptr
+#include <mutex> // unique_lock
+#include <shared_mutex>
+#include <optional>
+
+#include "HashTable.h"
+
+using namespace std;
+
+namespace csi281 {
+    template
+    <typename K, typename V, typename Hash = KeyHash<K>, typename KeyEqual = equal_to<> >
+    class ConcurrentHashTable {
+    public:
+        static constexpr int DEFAULT_SHARDS = 16;
+
+        // shards is rounded up to a power of two; capacity is per shard
+        ConcurrentHashTable(int shards = DEFAULT_SHARDS, int capacity = HashTable<K, V, Hash, KeyEqual>::DEFAULT_CAPACITY,
+                            const Hash &hashFunction = Hash(), const KeyEqual &keyEqual = KeyEqual())
+            : key_hash(hashFunction) {
+            if (shards < 1)
+                shards = DEFAULT_SHARDS;
+
+            shard_count = (int) PowerOfTwoBuckets::roundSlots(shards);
+            while ((1 << shard_bits) < shard_count)
+                shard_bits++;
+
+            shardStore.reset(new Shard[shard_count]);
+            for (int i = 0; i < shard_count; i++)
+                shardStore[i].table.reset(new ShardTable(capacity, hashFunction, keyEqual));
+        }
+
+        ConcurrentHashTable(const ConcurrentHashTable &) = delete;
+        ConcurrentHashTable &operator=(const ConcurrentHashTable &) = delete;
+
+        void put(const K &key, const V &value) {
+            Shard &shard = shardFor(key);
+            unique_lock<shared_mutex> guard(shard.lock);
+            shard.table->put(key, value);
+        }
+
+        void put(K &&key, V &&value) {
+            Shard &shard = shardFor(key);
+            unique_lock<shared_mutex> guard(shard.lock);
+            shard.table->put(move(key), move(value));
+        }
+
+        // true if the key was inserted, false if it was already present
+        template <typename... Args>
+        bool tryEmplace(const K &key, Args &&...args) {
+            Shard &shard = shardFor(key);
+            unique_lock<shared_mutex> guard(shard.lock);
+            return shard.table->tryEmplace(key, forward<Args>(args)...).second;
+        }
+
+        template <typename KeyLike>
+        optional<V> getValue(const KeyLike &key) {
+            Shard &shard = shardFor(key);
+            shared_lock<shared_mutex> guard(shard.lock);
+            return shard.table->getValue(key);
+        }
+
+        template <typename KeyLike>
+        bool keyExists(const KeyLike &key) {
+            Shard &shard = shardFor(key);
+            shared_lock<shared_mutex> guard(shard.lock);
+            return shard.table->keyExists(key);
+        }
+
+        template <typename KeyLike>
+        void removeElement(const KeyLike &key) {
+            Shard &shard = shardFor(key);
+            unique_lock<shared_mutex> guard(shard.lock);
+            shard.table->removeElement(key);
+        }
+
+        // locks one shard at a time, so the sum is only a snapshot when
+        // other threads are writing
+        int getTotalElements() {
+            int total = 0;
+            for (int i = 0; i < shard_count; i++) {
+                shared_lock<shared_mutex> guard(shardStore[i].lock);
+                total += shardStore[i].table->getTotalElements();
+            }
+            return total;
+        }
+
+        int getShardCount() const { return shard_count; }
+
+    private:
+        using ShardTable = HashTable<K, V, Hash, KeyEqual>;
+
+        // Shard tables never use incremental resizing, so getValue()
+        // and keyExists() leave them untouched and can share the lock.
+        // Each shard sits on its own cache line to avoid false sharing.
+        struct alignas(64) Shard {
+            shared_mutex lock;
+            unique_ptr<ShardTable> table;
+        };
+
+        int shard_count = 0;
+        int shard_bits = 0;
+        Hash key_hash;
+        unique_ptr<Shard[]> shardStore;
+
+        // the shard tables reduce the low bits of the same hash to a
+        // bucket, so the shard is taken from the top bits of its mix
+        template <typename KeyLike>
+        Shard &shardFor(const KeyLike &key) {
+            if (shard_bits == 0)
+                return shardStore[0];
+            uint64_t mixed = (uint64_t) mixHash(key_hash(key));
+            return shardStore[mixed >> (64 - shard_bits)];
+        }
+    };
+}
+
+#endif /* concurrenthashtable_hpp */
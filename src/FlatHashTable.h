@@ -0,0 +1,221 @@
+//
+//  FlatHashTable.h
+//
+//  This file defines an open-addressing Hash Table class with the same
+//  put/getValue/removeElement interface as HashTable, but which keeps
+//  every entry inline in one contiguous slot array (Robin Hood linear
+//  probing) instead of in per-bucket linked lists.
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef flathashtable_hpp
+#define flathashtable_hpp
+
+#include <utility> // for pair, move(), swap()
+#include <functional> // for hash()
+#include <optional>
+#include <cstdint>
+#include <new> // placement new
+#include <iostream>
+
+#include "BucketPolicies.h"
+
+using namespace std;
+
+namespace csi281 {
+    template
+    <typename K, typename V>
+    class FlatHashTable {
+    public:
+        static constexpr int DEFAULT_SLOTS = 16;
+        static constexpr float MAX_LOAD = 0.875f;
+
+        FlatHashTable(int capacity = DEFAULT_SLOTS) {
+            if (isInvalidCapacity(capacity))
+                capacity = DEFAULT_SLOTS;
+
+            resizeHashTable((int) PowerOfTwoBuckets::roundSlots(capacity));
+        }
+
+        FlatHashTable(const FlatHashTable &) = delete;
+        FlatHashTable &operator=(const FlatHashTable &) = delete;
+
+        ~FlatHashTable() {
+            destroySlots(slots, array_slots);
+        }
+
+        void put(const K key, const V value) {
+            size_t hashKey = getHashKey(key);
+            size_t index = probe(key, hashKey);
+            if (index != NOT_FOUND) {
+                slots[index].entry.second = value;
+                return;
+            }
+
+            if (atMaxLoad())
+                resizeHashTable(array_slots * 2);
+            insertNewEntry(hashKey, make_pair(key, value));
+        }
+
+        bool keyExists(const K &key) { return locate(key) != nullptr; }
+
+        pair<K, V> *locate(const K &key) {
+            size_t index = probe(key, getHashKey(key));
+            if (index == NOT_FOUND)
+                return nullptr;
+            return &slots[index].entry;
+        }
+
+        optional<V> getValue(const K &key) {
+            pair<K, V> *element = locate(key);
+            if (element == nullptr)
+                return nullopt;
+            return element->second;
+        }
+
+        void removeElement(const K &key) {
+            size_t index = probe(key, getHashKey(key));
+            if (index == NOT_FOUND)
+                return;
+
+            slots[index].entry.~pair<K, V>();
+            shiftBackwardFrom(index);
+            total_elements--;
+        }
+
+        float getLoadFactor() { return ((float) total_elements) / ((float) array_slots); }
+
+        int getTotalElements() { return total_elements; }
+
+        int getArraySlots() { return array_slots; }
+
+        void printHashTable() {
+            for (int i = 0; i < array_slots; i++) {
+                cout << i << ":";
+                if (slots[i].isOccupied())
+                    cout << " -> (" << slots[i].entry.first << ", " << slots[i].entry.second << ")";
+                cout << endl;
+            }
+        }
+
+    private:
+        // distance is 0 for an empty slot, otherwise one more than the
+        // number of steps the entry sits away from its home slot
+        struct Slot {
+            uint32_t distance = 0;
+            union { pair<K, V> entry; };
+
+            Slot() {}
+            ~Slot() {}
+
+            bool isOccupied() const { return distance != 0; }
+        };
+
+        static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+        int array_slots = 0;
+        int total_elements = 0;
+        size_t slot_mask = 0;
+        hash<K> key_hash;
+        Slot *slots = nullptr;
+
+        bool isInvalidCapacity(int capacity) const { return capacity < 1; }
+
+        bool atMaxLoad() const { return (float) (total_elements + 1) > MAX_LOAD * (float) array_slots; }
+
+        size_t homeSlot(size_t hashKey) const { return hashKey & slot_mask; }
+
+        size_t nextSlot(size_t index) const { return (index + 1) & slot_mask; }
+
+        // Robin Hood ordering lets a miss stop as soon as it reaches an
+        // entry that is closer to its home slot than the key would be
+        size_t probe(const K &key, size_t hashKey) const {
+            size_t index = homeSlot(hashKey);
+            for (uint32_t distance = 1; slots[index].distance >= distance; distance++) {
+                if (slots[index].distance == distance && slots[index].entry.first == key)
+                    return index;
+                index = nextSlot(index);
+            }
+            return NOT_FOUND;
+        }
+
+        void insertNewEntry(size_t hashKey, pair<K, V> &&element) {
+            placeEntry(slots, homeSlot(hashKey), move(element));
+            total_elements++;
+        }
+
+        void placeEntry(Slot *target, size_t index, pair<K, V> &&element) {
+            uint32_t distance = 1;
+            while (target[index].isOccupied()) {
+                if (target[index].distance < distance) {
+                    swap(target[index].entry, element);
+                    swap(target[index].distance, distance);
+                }
+                index = nextSlot(index);
+                distance++;
+            }
+            new (&target[index].entry) pair<K, V>(move(element));
+            target[index].distance = distance;
+        }
+
+        void shiftBackwardFrom(size_t hole) {
+            size_t next = nextSlot(hole);
+            while (slots[next].distance > 1) {
+                new (&slots[hole].entry) pair<K, V>(move(slots[next].entry));
+                slots[hole].distance = slots[next].distance - 1;
+                slots[next].entry.~pair<K, V>();
+                hole = next;
+                next = nextSlot(next);
+            }
+            slots[hole].distance = 0;
+        }
+
+        void resizeHashTable(int new_array_slots) {
+            Slot *oldSlots = slots;
+            int old_array_slots = array_slots;
+
+            slots = new Slot[new_array_slots];
+            array_slots = new_array_slots;
+            slot_mask = (size_t) new_array_slots - 1;
+
+            for (int i = 0; i < old_array_slots; i++) {
+                if (oldSlots[i].isOccupied())
+                    placeEntry(slots, homeSlot(getHashKey(oldSlots[i].entry.first)), move(oldSlots[i].entry));
+            }
+            destroySlots(oldSlots, old_array_slots);
+        }
+
+        static void destroySlots(Slot *store, int store_slots) {
+            for (int i = 0; i < store_slots; i++) {
+                if (store[i].isOccupied())
+                    store[i].entry.~pair<K, V>();
+            }
+            delete[] store;
+        }
+
+        // std::hash is the identity for integers, which would leave
+        // masked linear probing with long runs; mix it first
+        size_t getHashKey(const K &key) { return mixHash(key_hash(key)); }
+    };
+}
+
+#endif /* flathashtable_hpp */
@@ -0,0 +1,216 @@
+//
+//  HashQuality.h
+//
+//  This file defines a diagnostic that measures how well a hash
+//  function spreads a set of keys. A poor hash does not break a
+//  HashTable, it only quietly turns lookups into long chain walks, so
+//  run new hash functions through analyzeHash() with a sample of real
+//  keys (or a populated table) before relying on them.
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef hashquality_hpp
+#define hashquality_hpp
+
+#include <algorithm> // sort(), max()
+#include <cmath> // fabs()
+#include <cstring> // memcpy()
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "HashTable.h"
+
+using namespace std;
+
+namespace csi281 {
+    struct HashQualityReport {
+        size_t keys = 0;
+        size_t buckets = 0;
+        // Pearson's chi-squared of the bucket counts against a uniform
+        // spread, and the same divided by its degrees of freedom; the
+        // normalized value is close to 1 for a good hash and grows with
+        // clustering
+        double chiSquared = 0;
+        double normalizedChiSquared = 0;
+        size_t longestChain = 0;
+        // fraction of keys whose full hash equals another key's, which
+        // no bucket count can separate
+        double collisionRate = 0;
+        // Average fraction of hash bits that change when one bit of a key
+        // is flipped (0.5 is ideal), and the largest distance from 0.5
+        // of any single output bit. Only measured for string keys and
+        // keys with no padding, bool or enum in their bytes; hasAvalanche
+        // is false otherwise.
+        bool hasAvalanche = false;
+        double avalanche = 0;
+        double worstBitBias = 0;
+
+        void print(ostream &out = cout) const {
+            out << "keys: " << keys << ", buckets: " << buckets << endl;
+            out << "chi-squared: " << chiSquared << " (" << normalizedChiSquared << " per degree of freedom)" << endl;
+            out << "longest chain: " << longestChain << endl;
+            out << "collision rate: " << collisionRate << endl;
+            if (hasAvalanche)
+                out << "avalanche: " << avalanche << " (worst bit bias " << worstBitBias << ")" << endl;
+        }
+    };
+
+    namespace quality {
+        // keys sampled for the avalanche test, and bytes flipped per key
+        constexpr size_t AVALANCHE_KEYS = 256;
+        constexpr size_t AVALANCHE_BYTES = 64;
+        constexpr size_t HASH_BITS = sizeof(size_t) * 8;
+
+        // Keys whose every byte takes part in their value, so any bit flip
+        // gives another valid key. Padding would count bits the hash
+        // rightly ignores, and a flipped bool or enum may not be a value
+        // of its type at all.
+        template <typename K>
+        constexpr bool hasFlippableBytes() {
+            return has_unique_object_representations<K>::value && is_default_constructible<K>::value
+                   && !is_same<K, bool>::value && !is_enum<K>::value;
+        }
+
+        template <typename K, typename Hash>
+        void flipBitsOf(const K &key, const Hash &hashFunction, vector<size_t> &bitFlips, size_t &trials) {
+            size_t original = hashFunction(key);
+            auto countFlips = [&](size_t changed) {
+                size_t difference = original ^ changed;
+                for (size_t bit = 0; bit < HASH_BITS; bit++)
+                    bitFlips[bit] += (difference >> bit) & 1;
+                trials++;
+            };
+
+            if constexpr (is_same<K, string>::value) {
+                string flipped = key;
+                for (size_t i = 0; i < min(flipped.size(), AVALANCHE_BYTES); i++) {
+                    for (int bit = 0; bit < 8; bit++) {
+                        flipped[i] = (char) (flipped[i] ^ (1 << bit));
+                        countFlips(hashFunction(flipped));
+                        flipped[i] = key[i];
+                    }
+                }
+            } else {
+                unsigned char bytes[sizeof(K)];
+                memcpy(bytes, &key, sizeof(K));
+                for (size_t i = 0; i < min(sizeof(K), AVALANCHE_BYTES); i++) {
+                    for (int bit = 0; bit < 8; bit++) {
+                        bytes[i] = (unsigned char) (bytes[i] ^ (1 << bit));
+                        K flipped;
+                        memcpy(&flipped, bytes, sizeof(K));
+                        countFlips(hashFunction(flipped));
+                        bytes[i] = (unsigned char) (bytes[i] ^ (1 << bit));
+                    }
+                }
+            }
+        }
+
+        template <typename K, typename Hash>
+        void measureAvalanche(const vector<const K *> &keys, const Hash &hashFunction, HashQualityReport &report) {
+            if constexpr (is_same<K, string>::value || hasFlippableBytes<K>()) {
+                vector<size_t> bitFlips(HASH_BITS);
+                size_t trials = 0;
+                size_t stride = max((size_t) 1, keys.size() / AVALANCHE_KEYS);
+                for (size_t i = 0; i < keys.size(); i += stride)
+                    flipBitsOf(*keys[i], hashFunction, bitFlips, trials);
+                if (trials == 0)
+                    return;
+
+                size_t totalFlips = 0;
+                for (size_t bit = 0; bit < HASH_BITS; bit++) {
+                    totalFlips += bitFlips[bit];
+                    double bias = fabs((double) bitFlips[bit] / (double) trials - 0.5);
+                    report.worstBitBias = max(report.worstBitBias, bias);
+                }
+                report.avalanche = (double) totalFlips / (double) (trials * HASH_BITS);
+                report.hasAvalanche = true;
+            }
+        }
+
+        template <typename K, typename Hash, typename BucketPolicy>
+        HashQualityReport analyze(const vector<const K *> &keys, size_t buckets, const Hash &hashFunction,
+                                  const BucketPolicy &bucketPolicy) {
+            HashQualityReport report;
+            report.keys = keys.size();
+            report.buckets = buckets;
+            if (keys.empty() || buckets == 0)
+                return report;
+
+            vector<size_t> hashes;
+            hashes.reserve(keys.size());
+            vector<size_t> chainLengths(buckets);
+            for (const K *key : keys) {
+                size_t hashKey = hashFunction(*key);
+                hashes.push_back(hashKey);
+                size_t &chain = chainLengths[bucketPolicy.index(hashKey)];
+                chain++;
+                report.longestChain = max(report.longestChain, chain);
+            }
+
+            double expected = (double) keys.size() / (double) buckets;
+            for (size_t chain : chainLengths)
+                report.chiSquared += ((double) chain - expected) * ((double) chain - expected) / expected;
+            report.normalizedChiSquared = buckets > 1 ? report.chiSquared / (double) (buckets - 1) : 0;
+
+            sort(hashes.begin(), hashes.end());
+            // every key in a run of equal hashes counts, the first included
+            size_t collisions = 0;
+            for (size_t i = 0; i < hashes.size(); i++) {
+                if ((i > 0 && hashes[i] == hashes[i - 1]) || (i + 1 < hashes.size() && hashes[i] == hashes[i + 1]))
+                    collisions++;
+            }
+            report.collisionRate = (double) collisions / (double) hashes.size();
+
+            measureAvalanche(keys, hashFunction, report);
+            return report;
+        }
+    }
+
+    // Analyzes hashFunction over a sample of distinct keys, reduced to
+    // buckets the way a HashTable using BucketPolicy would
+    template <typename BucketPolicy = ModuloBuckets, typename K, typename Hash = KeyHash<K> >
+    HashQualityReport analyzeHash(const vector<K> &keys, size_t buckets, const Hash &hashFunction = Hash()) {
+        vector<const K *> sample;
+        sample.reserve(keys.size());
+        for (const K &key : keys)
+            sample.push_back(&key);
+        buckets = BucketPolicy::roundSlots(buckets);
+        return quality::analyze(sample, buckets, hashFunction, BucketPolicy(buckets));
+    }
+
+    // Analyzes a table's own keys, hash function and bucket reduction
+    // at its current size
+    template <typename K, typename V, typename Hash, typename KeyEqual, typename Allocator, typename BucketPolicy,
+              bool CacheHashCodes>
+    HashQualityReport analyzeHash(const HashTable<K, V, Hash, KeyEqual, Allocator, BucketPolicy, CacheHashCodes> &table) {
+        vector<const K *> sample;
+        sample.reserve(table.getTotalElements());
+        for (const pair<K, V> &element : table)
+            sample.push_back(&element.first);
+        size_t buckets = (size_t) table.getArraySlots();
+        return quality::analyze(sample, buckets, table.getHashFunction(), BucketPolicy(buckets));
+    }
+}
+
+#endif /* hashquality_hpp */
@@ -30,16 +30,30 @@
 #ifndef hashtable_hpp
 #define hashtable_hpp
 
-#include <utility> // for pair
+#include <utility> // for pair, move(), forward()
+#include <tuple> // for forward_as_tuple()
 #include <functional> // for hash()
 #include <list>
+#include <memory> // allocator, allocator_traits
 #include <optional>
-#include <algorithm> // find_if(), remove_if()
+#include <algorithm> // min(), max()
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits> // enable_if, void_t
+#include <vector>
+#include <iterator> // iterator_traits, distance(), forward_iterator_tag
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h> // _mm_prefetch()
+#endif
+#include <cstdint>
+#ifdef CSI281_HASHTABLE_STATS
+#include <atomic>
+#include <chrono>
+#endif
 
-#define DEFAULT_CAPACITY 10
-#define MAX_LOAD_FACTOR 0.7
-#define GROWTH_FACTOR 2
+#include "BucketPolicies.h"
+#include "NodePool.h"
 
 #define key_ first
 #define value_ second
@@ -47,52 +61,420 @@
 using namespace std;
 
 namespace csi281 {
+    // std::hash<K>, except that string keys get a transparent hasher
+    // that also accepts string_view and const char* lookups
+    template <typename K>
+    struct KeyHash : hash<K> {};
+
+    template <>
+    struct KeyHash<string> {
+        using is_transparent = void;
+
+        size_t operator()(string_view key) const { return hash<string_view>()(key); }
+    };
+
+    // Heap memory owned by a key or value, beyond sizeof itself, for
+    // HashTable::memoryUsage(). Specialize it for your own types.
+    template <typename T>
+    struct HeapUsage {
+        size_t operator()(const T &) const { return 0; }
+    };
+
+    template <>
+    struct HeapUsage<string> {
+        // short strings live inside the object itself
+        size_t operator()(const string &value) const {
+            const char *data = value.data();
+            const char *object = reinterpret_cast<const char *>(&value);
+            if (data >= object && data < object + sizeof(string))
+                return 0;
+            return value.capacity() + 1;
+        }
+    };
+
+    template <typename T, typename Allocator>
+    struct HeapUsage<vector<T, Allocator> > {
+        size_t operator()(const vector<T, Allocator> &value) const {
+            size_t bytes = value.capacity() * sizeof(T);
+            for (const T &element : value)
+                bytes += HeapUsage<T>()(element);
+            return bytes;
+        }
+    };
+
+    // Bytes a HashTable occupies, by where they go
+    struct HashTableMemoryUsage {
+        // the bucket headers, including the old and new stores mid-rehash
+        size_t bucketArray = 0;
+        // sizeof(pair<K, V>) for every entry
+        size_t entries = 0;
+        // the rest of each chain node: list links and any cached hash code
+        size_t nodeOverhead = 0;
+        // held by the table's NodePool but not in use by any node;
+        // 0 for allocators that hand freed nodes back to the heap
+        size_t slack = 0;
+        // what HeapUsage reports for every key and value, when asked for
+        size_t ownedHeap = 0;
+
+        size_t total() const { return bucketArray + entries + nodeOverhead + slack + ownedHeap; }
+    };
+
+    template <typename Hasher, typename = void>
+    struct IsTransparent : false_type {};
+
+    template <typename Hasher>
+    struct IsTransparent<Hasher, void_t<typename Hasher::is_transparent> > : true_type {};
+
+    template <typename Alloc, typename = void>
+    struct HasNodePool : false_type {};
+
+    template <typename Alloc>
+    struct HasNodePool<Alloc, void_t<decltype(declval<const Alloc &>().getPool()->getLiveBytes())> > : true_type {};
+
+    inline void prefetchForRead(const void *address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#else
+        (void) address;
+#endif
+    }
+
+#ifdef CSI281_HASHTABLE_STATS
+    // What a HashTable has been doing, collected only when the program is
+    // built with CSI281_HASHTABLE_STATS defined. A lookup is any search
+    // for a key, including the one every put and removal does; a walk is
+    // the number of chain nodes one search compared against.
+    struct HashTableStats {
+        uint64_t lookups = 0;
+        uint64_t inserts = 0;
+        uint64_t erases = 0;
+        uint64_t nodesWalked = 0;
+        uint64_t longestWalk = 0;
+        uint64_t resizes = 0;
+        // time spent inside resizeHashTable(); in incremental mode the
+        // building and migration done by later calls is not included
+        uint64_t resizeNanoseconds = 0;
+        // bucketOccupancy[n] is the number of buckets holding n entries
+        vector<size_t> bucketOccupancy;
+
+        double averageWalk() const { return lookups == 0 ? 0.0 : (double) nodesWalked / (double) lookups; }
+
+        string toJson() const {
+            string json = "{\"lookups\": " + to_string(lookups) + ", \"inserts\": " + to_string(inserts)
+                          + ", \"erases\": " + to_string(erases) + ", \"nodesWalked\": " + to_string(nodesWalked)
+                          + ", \"averageWalk\": " + to_string(averageWalk())
+                          + ", \"longestWalk\": " + to_string(longestWalk) + ", \"resizes\": " + to_string(resizes)
+                          + ", \"resizeNanoseconds\": " + to_string(resizeNanoseconds) + ", \"bucketOccupancy\": [";
+            for (size_t i = 0; i < bucketOccupancy.size(); i++) {
+                if (i > 0)
+                    json += ", ";
+                json += to_string(bucketOccupancy[i]);
+            }
+            return json + "]}";
+        }
+    };
+#endif
+
+    // The full hash kept with each entry when a HashTable caches hash
+    // codes: resizes reuse it instead of rehashing the key, and lookups
+    // compare it before calling KeyEqual. Empty when caching is off.
+    template <bool Enabled>
+    class CachedHashCode {
+    public:
+        explicit CachedHashCode(size_t hashKey) : hashKey(hashKey) {}
+
+        bool mayEqual(size_t otherHashKey) const { return hashKey == otherHashKey; }
+
+        size_t getHashCode() const { return hashKey; }
+
+        void setHashCode(size_t newHashKey) { hashKey = newHashKey; }
+
+    private:
+        size_t hashKey;
+    };
+
+    template <>
+    class CachedHashCode<false> {
+    public:
+        explicit CachedHashCode(size_t) {}
+
+        bool mayEqual(size_t) const { return true; }
+
+        void setHashCode(size_t) {}
+    };
+
+    // Stores a policy object as a base class when it is empty, so that
+    // stateless hashers, comparators and allocators take up no space
+    template <typename Policy, int Tag, bool = is_empty<Policy>::value && !is_final<Policy>::value>
+    class PolicyHolder {
+    public:
+        explicit PolicyHolder(const Policy &policy) : policy(policy) {}
+
+        Policy &get() { return policy; }
+        const Policy &get() const { return policy; }
+
+    private:
+        Policy policy;
+    };
+
+    template <typename Policy, int Tag>
+    class PolicyHolder<Policy, Tag, true> : private Policy {
+    public:
+        explicit PolicyHolder(const Policy &policy) : Policy(policy) {}
+
+        Policy &get() { return *this; }
+        const Policy &get() const { return *this; }
+    };
+
     template
-    <typename K, typename V>
-    class HashTable {
+    <typename K, typename V, typename Hash = KeyHash<K>, typename KeyEqual = equal_to<>,
+     typename Allocator = allocator<pair<K, V> >, typename BucketPolicy = ModuloBuckets,
+     bool CacheHashCodes = false>
+    class HashTable : private PolicyHolder<Hash, 0>, private PolicyHolder<KeyEqual, 1>,
+                      private PolicyHolder<Allocator, 2> {
+        using HashHolder = PolicyHolder<Hash, 0>;
+        using KeyEqualHolder = PolicyHolder<KeyEqual, 1>;
+        using AllocatorHolder = PolicyHolder<Allocator, 2>;
+
+        struct Entry : CachedHashCode<CacheHashCodes> {
+            template <typename... Args>
+            explicit Entry(size_t hashKey, Args &&...args)
+                : CachedHashCode<CacheHashCodes>(hashKey), element(forward<Args>(args)...) {}
+
+            pair<K, V> element;
+        };
+
+        using EntryAllocator = typename allocator_traits<Allocator>::template rebind_alloc<Entry>;
+        using Bucket = list<Entry, EntryAllocator>;
+        using BucketAllocator = typename allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+
+        template <typename KeyLike>
+        using EnableIfTransparent = typename enable_if<IsTransparent<Hash>::value && IsTransparent<KeyEqual>::value
+                                                       && !is_same<KeyLike, K>::value, int>::type;
+
+        // Walks each bucket of the backing store in turn and then, while
+        // an incremental resize is underway, the old store's buckets
+        // that have not been migrated yet. A null bucket marks the end.
+        template <bool IsConst>
+        class Iterator {
+            using BucketPointer = typename conditional<IsConst, const Bucket *, Bucket *>::type;
+            using EntryIterator = typename conditional<IsConst, typename Bucket::const_iterator,
+                                                       typename Bucket::iterator>::type;
+
+        public:
+            using iterator_category = forward_iterator_tag;
+            using value_type = pair<K, V>;
+            using difference_type = ptrdiff_t;
+            using pointer = typename conditional<IsConst, const pair<K, V> *, pair<K, V> *>::type;
+            using reference = typename conditional<IsConst, const pair<K, V> &, pair<K, V> &>::type;
+
+            Iterator() = default;
+
+            operator Iterator<true>() const {
+                return Iterator<true>(bucket, bucketsEnd, pendingBuckets, pendingBucketsEnd, entry);
+            }
+
+            reference operator*() const { return entry->element; }
+
+            pointer operator->() const { return &entry->element; }
+
+            Iterator &operator++() {
+                ++entry;
+                skipEmptyBuckets();
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator previous = *this;
+                ++*this;
+                return previous;
+            }
+
+            template <bool OtherConst>
+            bool operator==(const Iterator<OtherConst> &other) const {
+                return bucket == other.bucket && (bucket == nullptr || entry == other.entry);
+            }
+
+            template <bool OtherConst>
+            bool operator!=(const Iterator<OtherConst> &other) const { return !(*this == other); }
+
+        private:
+            friend class HashTable;
+            template <bool> friend class Iterator;
+
+            BucketPointer bucket = nullptr;
+            BucketPointer bucketsEnd = nullptr;
+            BucketPointer pendingBuckets = nullptr;
+            BucketPointer pendingBucketsEnd = nullptr;
+            EntryIterator entry;
+
+            Iterator(BucketPointer first, BucketPointer last, BucketPointer pendingFirst, BucketPointer pendingLast)
+                : bucket(first), bucketsEnd(last), pendingBuckets(pendingFirst), pendingBucketsEnd(pendingLast) {
+                if (bucket == bucketsEnd && !nextBucketRange())
+                    return;
+                entry = bucket->begin();
+                skipEmptyBuckets();
+            }
+
+            Iterator(BucketPointer current, BucketPointer last, BucketPointer pendingFirst, BucketPointer pendingLast,
+                     EntryIterator entry)
+                : bucket(current), bucketsEnd(last), pendingBuckets(pendingFirst), pendingBucketsEnd(pendingLast),
+                  entry(entry) {}
+
+            void skipEmptyBuckets() {
+                while (entry == bucket->end()) {
+                    if (++bucket == bucketsEnd && !nextBucketRange())
+                        return;
+                    entry = bucket->begin();
+                }
+            }
+
+            // false, and the iterator becomes end(), when nothing is left
+            bool nextBucketRange() {
+                bucket = pendingBuckets;
+                bucketsEnd = pendingBucketsEnd;
+                pendingBuckets = pendingBucketsEnd = nullptr;
+                if (bucket != bucketsEnd)
+                    return true;
+                bucket = bucketsEnd = nullptr;
+                return false;
+            }
+        };
+
     public:
-        HashTable(int capacity = DEFAULT_CAPACITY) {
+        using key_type = K;
+        using mapped_type = V;
+        using value_type = pair<K, V>;
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+        // defaults for the per-instance settings below
+        static constexpr int DEFAULT_CAPACITY = 10;
+        static constexpr double DEFAULT_MAX_LOAD_FACTOR = 0.7;
+        static constexpr double DEFAULT_GROWTH_FACTOR = 2;
+
+        HashTable(int capacity = DEFAULT_CAPACITY, const Hash &hashFunction = Hash(),
+                  const KeyEqual &keyEqual = KeyEqual(), const Allocator &allocator = Allocator())
+            : HashHolder(hashFunction), KeyEqualHolder(keyEqual), AllocatorHolder(allocator) {
             if (isInvalidCapacity(capacity))
                 capacity = DEFAULT_CAPACITY;
 
+            capacity_array_slots = (int) BucketPolicy::roundSlots(capacity);
+            minimum_array_slots = capacity_array_slots;
             resizeHashTable(capacity);
         }
 
+        template <typename InputIt, typename = typename iterator_traits<InputIt>::iterator_category>
+        HashTable(InputIt first, InputIt last, int capacity = DEFAULT_CAPACITY, const Hash &hashFunction = Hash(),
+                  const KeyEqual &keyEqual = KeyEqual(), const Allocator &allocator = Allocator())
+            : HashTable(capacity, hashFunction, keyEqual, allocator) {
+            putMany(first, last);
+        }
+
         ~HashTable() {
-            delete[] backingStore;
+            releaseBuildingBackingStore();
+            releaseOldBackingStore();
+            destroyBackingStore(backingStore, array_slots);
         }
 
-        void put(const K key, const V value) {
-            if(keyExists(key)) {
-                updateValue(key, value);
-                return;
-            }
-            insertNewKey(key, value);
+        void put(const K &key, const V &value) {
+            insertOrAssign(key, value);
+        }
 
-            if (atMAX_LOAD_FACTOR())
-                resizeHashTable(array_slots * GROWTH_FACTOR);
+        void put(K &&key, V &&value) {
+            insertOrAssign(move(key), move(value));
+        }
+
+        // Each of these hashes the key once and walks its bucket once,
+        // returning the entry they touched and whether it was inserted.
+        // New entries are constructed in place from the forwarded arguments.
+        template <typename M>
+        pair<pair<K, V> *, bool> insertOrAssign(const K &key, M &&value) {
+            return assignOrEmplace(key, forward<M>(value));
         }
 
-        void insertNewKey(const K key, const V value) {
-            backingStore[findArraySlot(key, array_slots)].push_back(make_pair(key, value));
+        template <typename M>
+        pair<pair<K, V> *, bool> insertOrAssign(K &&key, M &&value) {
+            return assignOrEmplace(move(key), forward<M>(value));
+        }
+
+        template <typename... Args>
+        pair<pair<K, V> *, bool> tryEmplace(const K &key, Args &&...args) {
+            return findOrEmplace(key, forward<Args>(args)...);
+        }
+
+        template <typename... Args>
+        pair<pair<K, V> *, bool> tryEmplace(K &&key, Args &&...args) {
+            return findOrEmplace(move(key), forward<Args>(args)...);
+        }
+
+        // builds the pair first, like std::unordered_map::emplace(), and
+        // drops it again if the key turns out to be present already
+        template <typename... Args>
+        pair<pair<K, V> *, bool> emplace(Args &&...args) {
+            Bucket node(getAllocator());
+            node.emplace_back(0, forward<Args>(args)...);
+
+            rehashStep();
+            const K &key = node.front().element.key_;
+            size_t hashKey = getHashKey(key);
+            pair<K, V> *element = locateHashed(key, hashKey);
+            if (element != nullptr)
+                return make_pair(element, false);
+
+            node.front().setHashCode(hashKey);
+            Bucket &bucket = bucketForInsert(hashKey);
+            bucket.splice(bucket.end(), node);
             total_elements++;
+            countInsert();
+            return make_pair(&bucket.back().element, true);
         }
 
-        bool keyExists(const K key) {
-            if (locate(key) == nullptr)
-                return false;
+        // Puts every key/value pair in [first, last). When the range can
+        // be counted the table is sized once for the final load, any
+        // incremental resize is finished, and the pairs go straight into
+        // their buckets with no further load checks; later duplicates
+        // overwrite earlier ones, as with put().
+        template <typename InputIt>
+        void putMany(InputIt first, InputIt last) {
+            using Category = typename iterator_traits<InputIt>::iterator_category;
+            if constexpr (is_base_of<forward_iterator_tag, Category>::value) {
+                reserve(total_elements + (size_t) distance(first, last));
+                finishRehash();
+                for (; first != last; ++first)
+                    assignOrEmplaceInto(first->first, first->second);
+            } else {
+                for (; first != last; ++first)
+                    insertOrAssign(first->first, first->second);
+            }
+        }
 
-            return true;
+        void insertNewKey(const K &key, const V &value) {
+            size_t hashKey = getHashKey(key);
+            emplaceInto(backingStore[bucketPolicy.index(hashKey)], hashKey, key, value);
+        }
+
+        // Lookups also accept any KeyLike that the hasher is transparent
+        // for, e.g. string_view or const char* for string keys, hashing
+        // and comparing it directly instead of materializing a K
+        bool keyExists(const K &key) {
+            return locate(key) != nullptr;
+        }
+
+        template <typename KeyLike, EnableIfTransparent<KeyLike> = 0>
+        bool keyExists(const KeyLike &key) {
+            return locate(key) != nullptr;
         }
 
         pair<K, V> *locate(const K &key) {
-            for (pair<K, V>& element : backingStore[findArraySlot(key, array_slots)]) {
-                if (element.key_ == key) {
-                    return &element;
-                }
-            }
-            // return nullptr if the item is not found
-            return nullptr;
+            return locateHashed(key, getHashKey(key));
+        }
+
+        template <typename KeyLike, EnableIfTransparent<KeyLike> = 0>
+        pair<K, V> *locate(const KeyLike &key) {
+            return locateHashed(key, getHashKey(key));
         }
 
         void updateValue(const K key, const V value) {
@@ -100,86 +482,710 @@ namespace csi281 {
         }
 
         optional<V> getValue(const K &key) {
-            if (!keyExists(key))
-                return nullopt;
-            return locate(key)->value_;
+            return lookupValue(key);
+        }
+
+        template <typename KeyLike, EnableIfTransparent<KeyLike> = 0>
+        optional<V> getValue(const KeyLike &key) {
+            return lookupValue(key);
         }
         
         void removeElement(const K &key) {
-            backingStore[findArraySlot(key, array_slots)].remove(*locate(key));
-            total_elements--;
+            removeKey(key);
+        }
+
+        template <typename KeyLike, EnableIfTransparent<KeyLike> = 0>
+        void removeElement(const KeyLike &key) {
+            removeKey(key);
+        }
+
+        // Looks up count keys into out. Keys are resolved in batches:
+        // every key in a batch is hashed and its bucket prefetched, then
+        // each bucket's first node is prefetched, and only then are the
+        // chains walked, so the cache misses of a batch overlap.
+        void getMany(const K *keys, size_t count, optional<V> *out) {
+            size_t hashKeys[GET_MANY_BATCH];
+            Bucket *buckets[GET_MANY_BATCH];
+
+            for (size_t batchStart = 0; batchStart < count; batchStart += GET_MANY_BATCH) {
+                size_t batchSize = min(GET_MANY_BATCH, count - batchStart);
+                rehashStep();
+
+                for (size_t i = 0; i < batchSize; i++) {
+                    hashKeys[i] = getHashKey(keys[batchStart + i]);
+                    buckets[i] = &backingStore[bucketPolicy.index(hashKeys[i])];
+                    prefetchForRead(buckets[i]);
+                }
+                for (size_t i = 0; i < batchSize; i++) {
+                    if (!buckets[i]->empty())
+                        prefetchForRead(&buckets[i]->front());
+                }
+                for (size_t i = 0; i < batchSize; i++) {
+                    pair<K, V> *element = locateHashed(keys[batchStart + i], hashKeys[i]);
+                    if (element == nullptr)
+                        out[batchStart + i] = nullopt;
+                    else
+                        out[batchStart + i] = element->value_;
+                }
+            }
+        }
+
+        vector<optional<V> > getMany(const vector<K> &keys) {
+            vector<optional<V> > values(keys.size());
+            getMany(keys.data(), keys.size(), values.data());
+            return values;
         }
 
-        float getLoadFactor() { return ((float) total_elements) / ((float) array_slots); }
+        // Iteration order is unspecified. Any insert or removal, and any
+        // lookup while an incremental resize is underway, invalidates
+        // iterators.
+        iterator begin() {
+            return iterator(backingStore, backingStore + array_slots, pendingOldBuckets(), oldBackingStore + old_array_slots);
+        }
+
+        iterator end() { return iterator(); }
+
+        const_iterator begin() const {
+            return const_iterator(backingStore, backingStore + array_slots, pendingOldBuckets(),
+                                  oldBackingStore + old_array_slots);
+        }
+
+        const_iterator end() const { return const_iterator(); }
+
+        const_iterator cbegin() const { return begin(); }
+
+        const_iterator cend() const { return end(); }
+
+        float getLoadFactor() const { return ((float) total_elements) / ((float) array_slots); }
         
-        int getTotalElements() { return total_elements; }
+        int getTotalElements() const { return total_elements; }
         
-        int getArraySlots() { return array_slots; }
+        int getArraySlots() const { return array_slots; }
 
-        void setArraySlots(size_t newSize) { array_slots = newSize; }
+        // The table's footprint. Node sizes are estimated as a list node
+        // of two links around the entry, rounded up to a whole pool block
+        // for pooled tables; with includeOwnedHeap every key and value is
+        // also visited and measured with HeapUsage.
+        HashTableMemoryUsage memoryUsage(bool includeOwnedHeap = false) const {
+            HashTableMemoryUsage usage;
+            usage.bucketArray = (size_t) (array_slots + old_array_slots + building_array_slots) * sizeof(Bucket);
+            usage.entries = (size_t) total_elements * sizeof(pair<K, V>);
+            size_t nodeBytes = NODE_BYTES;
+            if constexpr (HasNodePool<Allocator>::value) {
+                const NodePool &pool = *getAllocator().getPool();
+                nodeBytes = NodePool::roundUpBlockSize(NODE_BYTES);
+                usage.slack = pool.getReservedBytes() - pool.getLiveBytes();
+            }
+            usage.nodeOverhead = (size_t) total_elements * (nodeBytes - sizeof(pair<K, V>));
+            if (includeOwnedHeap) {
+                for (const pair<K, V> &element : *this)
+                    usage.ownedHeap += HeapUsage<K>()(element.key_) + HeapUsage<V>()(element.value_);
+            }
+            return usage;
+        }
 
-        void updateBackingStore(list<pair<K, V> > *newBackingStore) {
-            delete[] backingStore;
-            backingStore = newBackingStore;
+        // Grows the backing store so that elements entries fit below
+        // the max load factor; never shrinks. Removals will not shrink
+        // the table below the reserved size either.
+        void reserve(size_t elements) {
+            size_t needed = slotsToHold(elements);
+            minimum_array_slots = max(minimum_array_slots, (int) BucketPolicy::roundSlots(needed));
+            if (needed > (size_t) array_slots)
+                rebuildBackingStore(needed);
+        }
+
+        // Rebuilds the backing store with array_slots_wanted buckets, or
+        // with as many as the current elements need if that is more.
+        // Removals will not shrink the table below array_slots_wanted.
+        void rehash(size_t array_slots_wanted) {
+            minimum_array_slots = max(capacity_array_slots, (int) BucketPolicy::roundSlots(array_slots_wanted));
+            size_t slots = max(array_slots_wanted, slotsToHold(total_elements));
+            if (BucketPolicy::roundSlots(slots) != (size_t) array_slots)
+                rebuildBackingStore(slots);
+        }
+
+        // Releases buckets left over after mass removals, and lets
+        // removals shrink the table down to its constructed capacity again
+        void shrinkToFit() {
+            rehash(0);
         }
 
-        bool atMAX_LOAD_FACTOR() { return getLoadFactor() >= MAX_LOAD_FACTOR; }
+        bool atMAX_LOAD_FACTOR() const { return getLoadFactor() >= max_load_factor; }
+
+        bool nextInsertReachesMaxLoad() const { return ((float) (total_elements + 1)) / ((float) array_slots) >= max_load_factor; }
+
+        // Inserts that would reach this load factor grow the table first.
+        // Lowering it below the current load rebuilds the backing store.
+        void setMaxLoadFactor(float maxLoadFactor) {
+            if (maxLoadFactor <= 0)
+                maxLoadFactor = (float) DEFAULT_MAX_LOAD_FACTOR;
+
+            max_load_factor = maxLoadFactor;
+            capMinLoadFactor();
+            if (atMAX_LOAD_FACTOR())
+                rebuildBackingStore(slotsToHold(total_elements));
+        }
+
+        float getMaxLoadFactor() const { return (float) max_load_factor; }
+
+        // How many times larger the backing store gets when it grows,
+        // and smaller when it shrinks. The min load factor is capped
+        // again for the new factor.
+        void setGrowthFactor(float growthFactor) {
+            if (growthFactor <= 1)
+                growthFactor = (float) DEFAULT_GROWTH_FACTOR;
+
+            growth_factor = growthFactor;
+            capMinLoadFactor();
+        }
+
+        float getGrowthFactor() const { return (float) growth_factor; }
 
         bool isInvalidCapacity(int capacity) const { return capacity < 1; }
 
         bool isElementsToMove() const { return total_elements > 0; }
 
-        size_t findArraySlot(const K key, const size_t capacity) { return (getHashKey(key) % capacity); }
+        // When enabled, growing the table only allocates the new backing
+        // store. Every later put, getValue or removeElement first
+        // constructs a few of its buckets and, once they are all built,
+        // migrates a few of the old store's buckets into it, destroying
+        // them as it goes, so no single call pays for rehashing the whole
+        // table. Inserts keep going into the old store while the new one
+        // is built.
+        void setIncrementalResize(bool enabled) {
+            if (!enabled)
+                finishRehash();
+            incremental_resize = enabled;
+        }
+
+        bool isIncrementalResize() const { return incremental_resize; }
+
+        bool isRehashing() const { return buildingBackingStore != nullptr || isMigrating(); }
+
+        // Removals that leave the load factor below this divide the
+        // number of array slots by the growth factor, down to the capacity
+        // the table was constructed or reserved with; 0 turns shrinking
+        // off. It is capped at the max load factor over the growth factor
+        // squared so that a table that has just grown or shrunk needs its
+        // element count to change by another growth factor before the
+        // opposite resize, which keeps it from thrashing at a threshold.
+        // The requested value is kept and the cap applied to it afresh
+        // whenever either factor changes.
+        void setMinLoadFactor(float minLoadFactor) {
+            requested_min_load_factor = max(0.0f, minLoadFactor);
+            capMinLoadFactor();
+        }
+
+        float getMinLoadFactor() const { return min_load_factor; }
+
+        Hash getHashFunction() const { return static_cast<const HashHolder &>(*this).get(); }
+
+        KeyEqual getKeyEqual() const { return static_cast<const KeyEqualHolder &>(*this).get(); }
+
+        Allocator getAllocator() const { return static_cast<const AllocatorHolder &>(*this).get(); }
+
+        size_t findArraySlot(const K &key) { return bucketPolicy.index(getHashKey(key)); }
+
+#ifdef CSI281_HASHTABLE_STATS
+        // the counters so far, plus the current bucket occupancy
+        HashTableStats getStats() const {
+            HashTableStats snapshot;
+            snapshot.lookups = stats.lookups.load(memory_order_relaxed);
+            snapshot.inserts = stats.inserts.load(memory_order_relaxed);
+            snapshot.erases = stats.erases.load(memory_order_relaxed);
+            snapshot.nodesWalked = stats.nodesWalked.load(memory_order_relaxed);
+            snapshot.longestWalk = stats.longestWalk.load(memory_order_relaxed);
+            snapshot.resizes = stats.resizes.load(memory_order_relaxed);
+            snapshot.resizeNanoseconds = stats.resizeNanoseconds.load(memory_order_relaxed);
+            addOccupancy(snapshot.bucketOccupancy, backingStore, array_slots);
+            if (isMigrating())
+                addOccupancy(snapshot.bucketOccupancy, pendingOldBuckets(), old_array_slots - rehash_index);
+            return snapshot;
+        }
+
+        void resetStats() {
+            for (atomic<uint64_t> *counter : {&stats.lookups, &stats.inserts, &stats.erases, &stats.nodesWalked,
+                                              &stats.longestWalk, &stats.resizes, &stats.resizeNanoseconds})
+                counter->store(0, memory_order_relaxed);
+        }
+#endif
 
         void printHashTable() {
+            finishRehash();
             for (int i = 0; i < array_slots; i++) {
                 cout << i << ":";
-                for (pair<K, V>& element : backingStore[i]) {
-                    cout << " -> (" << element.key_ << ", " << element.value_ << ")";
+                for (Entry &entry : backingStore[i]) {
+                    cout << " -> (" << entry.element.key_ << ", " << entry.element.value_ << ")";
                 }
                 cout << endl;
             }
         }
         
     private:
+        static constexpr size_t GET_MANY_BATCH = 16;
+        static constexpr int REHASH_BUCKETS_PER_STEP = 4;
+        static constexpr int REHASH_EMPTY_VISITS_PER_STEP = 40;
+        static constexpr int REHASH_BUCKETS_BUILT_PER_STEP = 256;
+
+        static constexpr float DEFAULT_MIN_LOAD_FACTOR = 0.1f;
+
+        static constexpr size_t NODE_BYTES = (sizeof(Entry) + 2 * sizeof(void *) + alignof(Entry) - 1)
+                                             / alignof(Entry) * alignof(Entry);
+
         int array_slots = 0;
         int total_elements = 0;
-        hash<K> key_hash;
-        list<pair<K, V> > *backingStore = nullptr;
+        // removals never shrink the table below minimum_array_slots,
+        // which reserve() and rehash() raise above the constructed capacity
+        int capacity_array_slots = 0;
+        int minimum_array_slots = 0;
+        float min_load_factor = DEFAULT_MIN_LOAD_FACTOR;
+        float requested_min_load_factor = DEFAULT_MIN_LOAD_FACTOR;
+        double max_load_factor = DEFAULT_MAX_LOAD_FACTOR;
+        double growth_factor = DEFAULT_GROWTH_FACTOR;
+        BucketPolicy bucketPolicy;
+        Bucket *backingStore = nullptr;
+
+        // the store being drained while an incremental resize is underway;
+        // buckets below rehash_index have already been moved over and destroyed
+        bool incremental_resize = false;
+        int old_array_slots = 0;
+        int rehash_index = 0;
+        BucketPolicy oldBucketPolicy;
+        Bucket *oldBackingStore = nullptr;
+
+        // the store an incremental resize is constructing before the
+        // migration starts; buckets below built_slots are constructed
+        int building_array_slots = 0;
+        int built_slots = 0;
+        Bucket *buildingBackingStore = nullptr;
+
+        // with CSI281_HASHTABLE_STATS undefined the count functions are
+        // empty and the table carries no counters
+#ifdef CSI281_HASHTABLE_STATS
+        // relaxed atomics, because ConcurrentHashTable runs lookups on a
+        // shard from several threads under a shared lock
+        struct StatsCounters {
+            atomic<uint64_t> lookups{0};
+            atomic<uint64_t> inserts{0};
+            atomic<uint64_t> erases{0};
+            atomic<uint64_t> nodesWalked{0};
+            atomic<uint64_t> longestWalk{0};
+            atomic<uint64_t> resizes{0};
+            atomic<uint64_t> resizeNanoseconds{0};
+        };
+
+        StatsCounters stats;
+
+        void countLookup() { stats.lookups.fetch_add(1, memory_order_relaxed); }
+
+        void countWalk(uint64_t nodes) {
+            stats.nodesWalked.fetch_add(nodes, memory_order_relaxed);
+            uint64_t longest = stats.longestWalk.load(memory_order_relaxed);
+            while (nodes > longest && !stats.longestWalk.compare_exchange_weak(longest, nodes, memory_order_relaxed)) {}
+        }
+
+        void countInsert() { stats.inserts.fetch_add(1, memory_order_relaxed); }
+
+        void countErase() { stats.erases.fetch_add(1, memory_order_relaxed); }
+
+        static void addOccupancy(vector<size_t> &occupancy, const Bucket *buckets, int bucket_count) {
+            for (int i = 0; i < bucket_count; i++) {
+                size_t entries = buckets[i].size();
+                if (occupancy.size() <= entries)
+                    occupancy.resize(entries + 1);
+                occupancy[entries]++;
+            }
+        }
+#else
+        void countLookup() {}
+
+        void countWalk(uint64_t) {}
+
+        void countInsert() {}
+
+        void countErase() {}
+#endif
         
-        void resizeHashTable(int new_array_slots) {
-            list<pair<K, V> > *newBackingStore = createNewBackingStore(new_array_slots);
+        void setArraySlots(size_t newSize) { array_slots = newSize; }
+
+        void capMinLoadFactor() {
+            float cap = (float) (max_load_factor / (growth_factor * growth_factor));
+            min_load_factor = min(requested_min_load_factor, cap);
+        }
 
-            if (isElementsToMove())
-                moveElementsOver(new_array_slots, newBackingStore);
+        void updateBackingStore(Bucket *newBackingStore) {
+            destroyBackingStore(backingStore, array_slots);
+            backingStore = newBackingStore;
+        }
+
+        void resizeHashTable(int requested_array_slots) {
+#ifdef CSI281_HASHTABLE_STATS
+            chrono::steady_clock::time_point started = chrono::steady_clock::now();
+            bool constructed = backingStore != nullptr;
+#endif
+            finishRehash();
 
-            updateBackingStore(newBackingStore);
-            setArraySlots(new_array_slots);
+            int new_array_slots = (int) BucketPolicy::roundSlots(requested_array_slots);
+            if (incremental_resize && isElementsToMove()) {
+                buildingBackingStore = allocateBackingStore(new_array_slots);
+                building_array_slots = new_array_slots;
+                built_slots = 0;
+                buildStep();
+            } else {
+                BucketPolicy newBucketPolicy(new_array_slots);
+                Bucket *newBackingStore = createNewBackingStore(new_array_slots);
+                if (isElementsToMove())
+                    moveElementsOver(newBucketPolicy, newBackingStore);
+                updateBackingStore(newBackingStore);
+                setArraySlots(new_array_slots);
+                bucketPolicy = newBucketPolicy;
+            }
+#ifdef CSI281_HASHTABLE_STATS
+            if (constructed) {
+                stats.resizes.fetch_add(1, memory_order_relaxed);
+                stats.resizeNanoseconds.fetch_add((uint64_t) chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - started).count(), memory_order_relaxed);
+            }
+#endif
         }
 
-        void moveElementsOver(const int &new_array_slots, list<pair<K, V> > *newBackingStore) {
+        void moveElementsOver(const BucketPolicy &newBucketPolicy, Bucket *newBackingStore) {
             for (int currentIndex = 0; currentIndex < array_slots; currentIndex++) {
-                for (pair<K, V> element : backingStore[currentIndex]) {
-                    newBackingStore[findArraySlot(element.key_, new_array_slots)].push_back(element);
+                moveBucketOver(backingStore[currentIndex], newBucketPolicy, newBackingStore);
+            }
+        }
+
+        // splice the existing nodes across so no entry is copied or reallocated
+        void moveBucketOver(Bucket &bucket, const BucketPolicy &newBucketPolicy,
+                            Bucket *newBackingStore) {
+            while (!bucket.empty()) {
+                Bucket &newBucket = newBackingStore[newBucketPolicy.index(hashOf(bucket.front()))];
+                newBucket.splice(newBucket.end(), bucket, bucket.begin());
+            }
+        }
+
+        // construct a bounded number of new buckets or, once they are
+        // all built, migrate a bounded number of old buckets, skipping at
+        // most REHASH_EMPTY_VISITS_PER_STEP empty ones, as Redis does
+        void rehashStep() {
+            if (buildingBackingStore != nullptr) {
+                buildStep();
+                return;
+            }
+            if (!isMigrating())
+                return;
+
+            int first = rehash_index;
+            int moved = 0;
+            int emptyVisits = 0;
+            while (rehash_index < old_array_slots && moved < REHASH_BUCKETS_PER_STEP
+                   && emptyVisits < REHASH_EMPTY_VISITS_PER_STEP) {
+                Bucket &bucket = oldBackingStore[rehash_index++];
+                if (bucket.empty()) {
+                    emptyVisits++;
+                    continue;
+                }
+                moveBucketOver(bucket, bucketPolicy, backingStore);
+                moved++;
+            }
+            destroyBuckets(oldBackingStore + first, oldBackingStore + rehash_index);
+
+            if (rehash_index == old_array_slots)
+                releaseOldBackingStore();
+        }
+
+        void finishRehash() {
+            if (buildingBackingStore != nullptr) {
+                constructBuckets(buildingBackingStore + built_slots, buildingBackingStore + building_array_slots);
+                built_slots = building_array_slots;
+                startMigration();
+            }
+            if (!isMigrating())
+                return;
+
+            int first = rehash_index;
+            while (rehash_index < old_array_slots)
+                moveBucketOver(oldBackingStore[rehash_index++], bucketPolicy, backingStore);
+            destroyBuckets(oldBackingStore + first, oldBackingStore + rehash_index);
+            releaseOldBackingStore();
+        }
+
+        void buildStep() {
+            int last = min(built_slots + REHASH_BUCKETS_BUILT_PER_STEP, building_array_slots);
+            constructBuckets(buildingBackingStore + built_slots, buildingBackingStore + last);
+            built_slots = last;
+            if (built_slots == building_array_slots)
+                startMigration();
+        }
+
+        // the fully built store takes over and the current one starts draining into it
+        void startMigration() {
+            oldBackingStore = backingStore;
+            old_array_slots = array_slots;
+            oldBucketPolicy = bucketPolicy;
+            rehash_index = 0;
+            backingStore = buildingBackingStore;
+            setArraySlots(building_array_slots);
+            bucketPolicy = BucketPolicy(building_array_slots);
+            buildingBackingStore = nullptr;
+            building_array_slots = 0;
+            built_slots = 0;
+        }
+
+        void releaseBuildingBackingStore() {
+            if (buildingBackingStore == nullptr)
+                return;
+
+            destroyBuckets(buildingBackingStore, buildingBackingStore + built_slots);
+            deallocateBackingStore(buildingBackingStore, building_array_slots);
+            buildingBackingStore = nullptr;
+            building_array_slots = 0;
+            built_slots = 0;
+        }
+
+        bool isMigrating() const { return oldBackingStore != nullptr; }
+
+        // buckets below rehash_index were destroyed as they were migrated
+        void releaseOldBackingStore() {
+            if (oldBackingStore == nullptr)
+                return;
+
+            destroyBuckets(pendingOldBuckets(), oldBackingStore + old_array_slots);
+            deallocateBackingStore(oldBackingStore, old_array_slots);
+            oldBackingStore = nullptr;
+            old_array_slots = 0;
+            rehash_index = 0;
+        }
+
+        Bucket *pendingOldBuckets() const { return oldBackingStore + rehash_index; }
+
+        Bucket &oldBucketFor(size_t hashKey) { return oldBackingStore[oldBucketPolicy.index(hashKey)]; }
+
+        bool isOldBucketPending(size_t hashKey) const { return (int) oldBucketPolicy.index(hashKey) >= rehash_index; }
+
+        template <typename KeyArg, typename... Args>
+        pair<pair<K, V> *, bool> findOrEmplace(KeyArg &&key, Args &&...args) {
+            rehashStep();
+            size_t hashKey = getHashKey(key);
+            pair<K, V> *element = locateHashed(key, hashKey);
+            if (element != nullptr)
+                return make_pair(element, false);
+            return make_pair(emplaceHashed(hashKey, forward<KeyArg>(key), forward<Args>(args)...), true);
+        }
+
+        template <typename KeyArg, typename M>
+        pair<pair<K, V> *, bool> assignOrEmplace(KeyArg &&key, M &&value) {
+            rehashStep();
+            size_t hashKey = getHashKey(key);
+            pair<K, V> *element = locateHashed(key, hashKey);
+            if (element != nullptr) {
+                element->value_ = forward<M>(value);
+                return make_pair(element, false);
+            }
+            return make_pair(emplaceHashed(hashKey, forward<KeyArg>(key), forward<M>(value)), true);
+        }
+
+        template <typename KeyArg, typename... Args>
+        pair<K, V> *emplaceHashed(size_t hashKey, KeyArg &&key, Args &&...args) {
+            return emplaceInto(bucketForInsert(hashKey), hashKey, forward<KeyArg>(key), forward<Args>(args)...);
+        }
+
+        template <typename KeyArg, typename... Args>
+        pair<K, V> *emplaceInto(Bucket &bucket, size_t hashKey, KeyArg &&key, Args &&...args) {
+            bucket.emplace_back(hashKey, piecewise_construct, forward_as_tuple(forward<KeyArg>(key)),
+                                forward_as_tuple(forward<Args>(args)...));
+            total_elements++;
+            countInsert();
+            return &bucket.back().element;
+        }
+
+        // bulk-load insert: the caller has already sized the table and
+        // finished any rehash, so only the backing store is searched
+        template <typename KeyArg, typename M>
+        void assignOrEmplaceInto(KeyArg &&key, M &&value) {
+            size_t hashKey = getHashKey(key);
+            Bucket &bucket = backingStore[bucketPolicy.index(hashKey)];
+            countLookup();
+            pair<K, V> *element = locateInBucket(bucket, key, hashKey);
+            if (element != nullptr)
+                element->value_ = forward<M>(value);
+            else
+                emplaceInto(bucket, hashKey, forward<KeyArg>(key), forward<M>(value));
+        }
+
+        // smallest slot count that keeps elements below the max load factor
+        size_t slotsToHold(size_t elements) const {
+            size_t slots = (size_t) (elements / max_load_factor) + 1;
+            while (((float) elements) / ((float) slots) >= max_load_factor)
+                slots++;
+            return slots;
+        }
+
+        // one resize, done in full even in incremental mode
+        void rebuildBackingStore(size_t new_array_slots) {
+            resizeHashTable((int) new_array_slots);
+            finishRehash();
+        }
+
+        // grows the table first when this insert would reach the max load
+        // factor, unless a larger store is already being built
+        Bucket &bucketForInsert(size_t hashKey) {
+            if (nextInsertReachesMaxLoad() && buildingBackingStore == nullptr)
+                resizeHashTable(max(array_slots + 1, (int) (array_slots * growth_factor)));
+            return backingStore[bucketPolicy.index(hashKey)];
+        }
+
+        template <typename KeyLike>
+        optional<V> lookupValue(const KeyLike &key) {
+            rehashStep();
+            pair<K, V> *element = locate(key);
+            if (element == nullptr)
+                return nullopt;
+            return element->value_;
+        }
+
+        template <typename KeyLike>
+        void removeKey(const KeyLike &key) {
+            rehashStep();
+            size_t hashKey = getHashKey(key);
+            countLookup();
+            bool removed = isMigrating() && isOldBucketPending(hashKey)
+                           && eraseFromBucket(oldBucketFor(hashKey), key, hashKey);
+            if (!removed)
+                removed = eraseFromBucket(backingStore[bucketPolicy.index(hashKey)], key, hashKey);
+
+            if (removed && belowMinLoadFactor())
+                shrinkHashTable();
+        }
+
+        // a target that BucketPolicy rounds back up to the current
+        // size would only rebuild the table in place, so it is skipped
+        void shrinkHashTable() {
+            int target = max((int) (array_slots / growth_factor), minimum_array_slots);
+            if ((int) BucketPolicy::roundSlots(target) != array_slots)
+                resizeHashTable(target);
+        }
+
+        bool belowMinLoadFactor() const {
+            return array_slots > minimum_array_slots
+                   && ((float) total_elements) / ((float) array_slots) < min_load_factor;
+        }
+
+        template <typename KeyLike>
+        pair<K, V> *locateHashed(const KeyLike &key, size_t hashKey) {
+            countLookup();
+            if (isMigrating() && isOldBucketPending(hashKey)) {
+                pair<K, V> *element = locateInBucket(oldBucketFor(hashKey), key, hashKey);
+                if (element != nullptr)
+                    return element;
+            }
+            return locateInBucket(backingStore[bucketPolicy.index(hashKey)], key, hashKey);
+        }
+
+        template <typename KeyLike>
+        bool eraseFromBucket(Bucket &bucket, const KeyLike &key, size_t hashKey) {
+            uint64_t walked = 0;
+            for (auto entry = bucket.begin(); entry != bucket.end(); ++entry) {
+                walked++;
+                if (entryMatches(*entry, key, hashKey)) {
+                    countWalk(walked);
+                    bucket.erase(entry);
+                    total_elements--;
+                    countErase();
+                    return true;
                 }
             }
+            countWalk(walked);
+            return false;
         }
 
-        list<pair<K, V> > *createNewBackingStore(const int &new_array_slots) const {
-            list<pair<K, V> > *newBackingStore = new list<pair<K, V> >[new_array_slots];
-            for (int currentIndex = 0; currentIndex < new_array_slots; currentIndex++) {
-                newBackingStore[currentIndex] = list<pair<K, V> >();
+        template <typename KeyLike>
+        pair<K, V> *locateInBucket(Bucket &bucket, const KeyLike &key, size_t hashKey) {
+            uint64_t walked = 0;
+            for (Entry &entry : bucket) {
+                walked++;
+                if (entryMatches(entry, key, hashKey)) {
+                    countWalk(walked);
+                    return &entry.element;
+                }
             }
+            countWalk(walked);
+            // return nullptr if the item is not found
+            return nullptr;
+        }
+
+        Bucket *createNewBackingStore(const int &new_array_slots) const {
+            Bucket *newBackingStore = allocateBackingStore(new_array_slots);
+            constructBuckets(newBackingStore, newBackingStore + new_array_slots);
             return newBackingStore;
         }
 
-        // hash anything into an integer appropriate for
-        // the current array_slots
-        // TIP: use the std::hash key_hash defined as a private variable
-        size_t getHashKey(const K &key) {
-            return key_hash(key);
+        // raw memory only; large blocks come straight from the OS, so this
+        // does not touch every slot
+        Bucket *allocateBackingStore(int new_array_slots) const {
+            BucketAllocator bucketAllocator(getAllocator());
+            return allocator_traits<BucketAllocator>::allocate(bucketAllocator, new_array_slots);
+        }
+
+        void constructBuckets(Bucket *first, Bucket *last) const {
+            BucketAllocator bucketAllocator(getAllocator());
+            for (; first != last; ++first)
+                allocator_traits<BucketAllocator>::construct(bucketAllocator, first, getAllocator());
+        }
+
+        void destroyBackingStore(Bucket *store, int store_slots) const {
+            if (store == nullptr)
+                return;
+
+            destroyBuckets(store, store + store_slots);
+            deallocateBackingStore(store, store_slots);
+        }
+
+        void destroyBuckets(Bucket *first, Bucket *last) const {
+            BucketAllocator bucketAllocator(getAllocator());
+            for (; first != last; ++first)
+                allocator_traits<BucketAllocator>::destroy(bucketAllocator, first);
+        }
+
+        void deallocateBackingStore(Bucket *store, int store_slots) const {
+            BucketAllocator bucketAllocator(getAllocator());
+            allocator_traits<BucketAllocator>::deallocate(bucketAllocator, store, store_slots);
+        }
+
+        template <typename KeyLike>
+        bool keysEqual(const K &stored, const KeyLike &key) const {
+            return static_cast<const KeyEqualHolder &>(*this).get()(stored, key);
+        }
+
+        // a cached hash code that differs rules the key out without KeyEqual
+        template <typename KeyLike>
+        bool entryMatches(const Entry &entry, const KeyLike &key, size_t hashKey) const {
+            return entry.mayEqual(hashKey) && keysEqual(entry.element.key_, key);
+        }
+
+        size_t hashOf(const Entry &entry) const {
+            if constexpr (CacheHashCodes)
+                return entry.getHashCode();
+            else
+                return getHashKey(entry.element.key_);
+        }
+
+        // hash anything with the table's Hash; BucketPolicy
+        // then reduces it to one of the current array_slots
+        template <typename KeyLike>
+        size_t getHashKey(const KeyLike &key) const {
+            return static_cast<const HashHolder &>(*this).get()(key);
         }
     };
+
+    // a HashTable whose chain nodes come from its own NodePool
+    template <typename K, typename V>
+    using PooledHashTable = HashTable<K, V, KeyHash<K>, equal_to<>, PoolAllocator<pair<K, V> > >;
+
+    // a HashTable that stores each entry's hash code, for keys that are
+    // expensive to hash or compare such as long strings
+    template <typename K, typename V>
+    using CachedHashTable = HashTable<K, V, KeyHash<K>, equal_to<>, allocator<pair<K, V> >, ModuloBuckets, true>;
 }
 
 #endif /* hashtable_hpp */
@@ -0,0 +1,209 @@
+//
+//  NodePool.h
+//
+//  This file defines a slab allocator for HashTable chain nodes.
+//  Nodes are carved out of large slabs, freed nodes are kept on a free
+//  list for the next insert, and every slab is released in one go when
+//  the last table (and list) sharing the pool is destroyed. A pool is
+//  not synchronized, not even its count of users; like HashTable itself
+//  it belongs to one thread at a time.
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef nodepool_hpp
+#define nodepool_hpp
+
+#include <cstddef>
+#include <memory> // allocator
+#include <new> // operator new/delete
+#include <type_traits> // true_type
+#include <vector>
+
+using namespace std;
+
+namespace csi281 {
+    template <typename T>
+    class PoolAllocator;
+
+    class NodePool {
+    public:
+        static constexpr size_t FIRST_SLAB_BLOCKS = 64;
+        static constexpr size_t MAX_SLAB_BLOCKS = 65536;
+
+        NodePool() = default;
+        NodePool(const NodePool &) = delete;
+        NodePool &operator=(const NodePool &) = delete;
+
+        ~NodePool() {
+            for (void *slab : slabs)
+                ::operator delete(slab);
+        }
+
+        void *allocate(size_t bytes) {
+            SizeClass &sizeClass = sizeClassFor(bytes);
+            if (sizeClass.freeList != nullptr) {
+                FreeBlock *block = sizeClass.freeList;
+                sizeClass.freeList = block->next;
+                live_bytes += sizeClass.blockSize;
+                return block;
+            }
+
+            if (sizeClass.next == sizeClass.end)
+                addSlab(sizeClass);
+            void *block = sizeClass.next;
+            sizeClass.next += sizeClass.blockSize;
+            live_bytes += sizeClass.blockSize;
+            return block;
+        }
+
+        void deallocate(void *block, size_t bytes) {
+            SizeClass &sizeClass = sizeClassFor(bytes);
+            sizeClass.freeList = new (block) FreeBlock{sizeClass.freeList};
+            live_bytes -= sizeClass.blockSize;
+        }
+
+        size_t getSlabCount() const { return slabs.size(); }
+
+        size_t getReservedBytes() const { return reserved_bytes; }
+
+        // bytes in blocks currently handed out
+        size_t getLiveBytes() const { return live_bytes; }
+
+        // the block an allocation of bytes really takes up
+        static size_t roundUpBlockSize(size_t bytes) {
+            if (bytes < sizeof(FreeBlock))
+                bytes = sizeof(FreeBlock);
+            size_t alignment = alignof(max_align_t);
+            return (bytes + alignment - 1) / alignment * alignment;
+        }
+
+    private:
+        template <typename T>
+        friend class PoolAllocator;
+
+        struct FreeBlock {
+            FreeBlock *next;
+        };
+
+        // one per distinct node size; a table only ever has one or two
+        struct SizeClass {
+            size_t blockSize;
+            size_t slabBlocks;
+            FreeBlock *freeList;
+            char *next;
+            char *end;
+        };
+
+        vector<SizeClass> sizeClasses;
+        vector<void *> slabs;
+        size_t reserved_bytes = 0;
+        size_t live_bytes = 0;
+        // PoolAllocators pointing at this pool; the last one deletes it
+        size_t users = 1;
+
+        SizeClass &sizeClassFor(size_t bytes) {
+            size_t blockSize = roundUpBlockSize(bytes);
+            for (SizeClass &sizeClass : sizeClasses) {
+                if (sizeClass.blockSize == blockSize)
+                    return sizeClass;
+            }
+            sizeClasses.push_back(SizeClass{blockSize, FIRST_SLAB_BLOCKS, nullptr, nullptr, nullptr});
+            return sizeClasses.back();
+        }
+
+        void addSlab(SizeClass &sizeClass) {
+            size_t slabBytes = sizeClass.blockSize * sizeClass.slabBlocks;
+            char *slab = static_cast<char *>(::operator new(slabBytes));
+            slabs.push_back(slab);
+            reserved_bytes += slabBytes;
+
+            sizeClass.next = slab;
+            sizeClass.end = slab + slabBytes;
+            if (sizeClass.slabBlocks < MAX_SLAB_BLOCKS)
+                sizeClass.slabBlocks *= 2;
+        }
+    };
+
+    // Allocator that serves single-object allocations (list nodes) from
+    // a NodePool and anything else from the global allocator. A default
+    // constructed PoolAllocator creates a fresh pool; copies and rebound
+    // copies share it, so a HashTable and all of its buckets use one pool.
+    // Every bucket holds a copy, so the allocator is a single pointer and
+    // the pool's user count is a plain counter rather than a shared_ptr.
+    template <typename T>
+    class PoolAllocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = true_type;
+        using propagate_on_container_move_assignment = true_type;
+        using propagate_on_container_swap = true_type;
+
+        PoolAllocator() : pool(new NodePool()) {}
+
+        PoolAllocator(const PoolAllocator &other) : pool(other.pool) { pool->users++; }
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &other) : pool(other.getPool()) { pool->users++; }
+
+        PoolAllocator &operator=(const PoolAllocator &other) {
+            other.pool->users++;
+            releasePool();
+            pool = other.pool;
+            return *this;
+        }
+
+        ~PoolAllocator() { releasePool(); }
+
+        T *allocate(size_t n) {
+            if (isPooled(n))
+                return static_cast<T *>(pool->allocate(sizeof(T)));
+            return allocator<T>().allocate(n);
+        }
+
+        void deallocate(T *block, size_t n) {
+            if (isPooled(n))
+                pool->deallocate(block, sizeof(T));
+            else
+                allocator<T>().deallocate(block, n);
+        }
+
+        NodePool *getPool() const { return pool; }
+
+        template <typename U>
+        bool operator==(const PoolAllocator<U> &other) const { return pool == other.getPool(); }
+
+        template <typename U>
+        bool operator!=(const PoolAllocator<U> &other) const { return pool != other.getPool(); }
+
+    private:
+        NodePool *pool;
+
+        void releasePool() {
+            if (--pool->users == 0)
+                delete pool;
+        }
+
+        static bool isPooled(size_t n) { return n == 1 && alignof(T) <= alignof(max_align_t); }
+    };
+}
+
+#endif /* nodepool_hpp */
@@ -0,0 +1,330 @@
+//
+//  ReadMostlyHashTable.h
+//
+//  This file defines a concurrent Hash Table for workloads dominated by
+//  lookups. Readers never take a lock: they announce themselves in an
+//  epoch slot and walk immutable chain nodes. Writers serialize on one
+//  mutex and never change a node a reader may be looking at; updates,
+//  removals and resizes publish new nodes or a new bucket array with a
+//  single atomic store, and the old ones are retired and only freed
+//  once every reader that could still see them has left (epoch-based
+//  reclamation).
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef readmostlyhashtable_hpp
+#define readmostlyhashtable_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "HashTable.h"
+
+using namespace std;
+
+namespace csi281 {
+    // Every active reader holds one slot containing the epoch it started
+    // in. An object retired during epoch e may be freed once no slot
+    // holds an epoch <= e. All of the atomics here and in the table use
+    // the default sequentially consistent ordering; the argument above
+    // relies on the reader's slot store and the writer's unlink store
+    // being ordered against each other.
+    class EpochDomain {
+    public:
+        static constexpr int READER_SLOTS = 256;
+
+        class Guard {
+        public:
+            explicit Guard(EpochDomain &domain) : domain(domain), slot(domain.pin()) {}
+            Guard(const Guard &) = delete;
+            Guard &operator=(const Guard &) = delete;
+            ~Guard() { domain.unpin(slot); }
+
+        private:
+            EpochDomain &domain;
+            int slot;
+        };
+
+        // claims a free slot, starting from one picked by the thread id
+        // so that threads rarely collide
+        int pin() {
+            static thread_local size_t hint = hash<thread::id>()(this_thread::get_id());
+            for (size_t attempt = hint;; attempt++) {
+                ReaderSlot &reader = readers[attempt % READER_SLOTS];
+                uint64_t idle = IDLE;
+                if (reader.epoch.load() == IDLE && reader.epoch.compare_exchange_strong(idle, global_epoch.load())) {
+                    hint = attempt;
+                    return (int) (attempt % READER_SLOTS);
+                }
+            }
+        }
+
+        void unpin(int slot) { readers[slot].epoch.store(IDLE); }
+
+        // the epoch that objects unlinked before this call belong to
+        uint64_t advance() { return global_epoch.fetch_add(1); }
+
+        uint64_t oldestActiveEpoch() const {
+            uint64_t oldest = UINT64_MAX;
+            for (const ReaderSlot &reader : readers) {
+                uint64_t epoch = reader.epoch.load();
+                if (epoch != IDLE && epoch < oldest)
+                    oldest = epoch;
+            }
+            return oldest;
+        }
+
+    private:
+        static constexpr uint64_t IDLE = 0;
+
+        struct alignas(64) ReaderSlot {
+            atomic<uint64_t> epoch{IDLE};
+        };
+
+        atomic<uint64_t> global_epoch{1};
+        ReaderSlot readers[READER_SLOTS];
+    };
+
+    template
+    <typename K, typename V, typename Hash = KeyHash<K>, typename KeyEqual = equal_to<> >
+    class ReadMostlyHashTable {
+    public:
+        static constexpr int DEFAULT_CAPACITY = 10;
+        static constexpr double MAX_LOAD_FACTOR = 0.7;
+        static constexpr size_t GROWTH_FACTOR = 2;
+
+        ReadMostlyHashTable(int capacity = DEFAULT_CAPACITY, const Hash &hashFunction = Hash(),
+                            const KeyEqual &keyEqual = KeyEqual())
+            : key_hash(hashFunction), key_equal(keyEqual) {
+            if (capacity < 1)
+                capacity = DEFAULT_CAPACITY;
+
+            buckets.store(new BucketArray(PowerOfTwoBuckets::roundSlots(capacity)));
+        }
+
+        ReadMostlyHashTable(const ReadMostlyHashTable &) = delete;
+        ReadMostlyHashTable &operator=(const ReadMostlyHashTable &) = delete;
+
+        // no reader may still be inside the table when it is destroyed
+        ~ReadMostlyHashTable() {
+            BucketArray *current = buckets.load();
+            destroyNodes(current);
+            delete current;
+            for (Retired &retired : retiredList)
+                retired.destroy(retired.object);
+        }
+
+        template <typename KeyLike>
+        optional<V> getValue(const KeyLike &key) {
+            EpochDomain::Guard guard(domain);
+            const Node *node = findNode(key, getHashKey(key));
+            if (node == nullptr)
+                return nullopt;
+            return node->entry.second;
+        }
+
+        template <typename KeyLike>
+        bool keyExists(const KeyLike &key) {
+            EpochDomain::Guard guard(domain);
+            return findNode(key, getHashKey(key)) != nullptr;
+        }
+
+        // a changed value gets a new node that replaces the old one in
+        // its chain, so a reader sees either the old or the new pair
+        void put(const K &key, const V &value) {
+            lock_guard<mutex> guard(writer_lock);
+            size_t hashKey = getHashKey(key);
+            BucketArray *current = buckets.load();
+            atomic<Node *> *link = findLink(current, key, hashKey);
+            Node *existing = link->load();
+            if (existing != nullptr) {
+                link->store(new Node(hashKey, key, value, existing->next.load()));
+                retire(existing, domain.advance());
+            } else {
+                if (nextInsertReachesMaxLoad(current))
+                    current = growBucketArray(current);
+                atomic<Node *> &head = current->heads[current->index(hashKey)];
+                head.store(new Node(hashKey, key, value, head.load()));
+                total_elements++;
+            }
+            reclaim();
+        }
+
+        template <typename KeyLike>
+        void removeElement(const KeyLike &key) {
+            lock_guard<mutex> guard(writer_lock);
+            atomic<Node *> *link = findLink(buckets.load(), key, getHashKey(key));
+            Node *existing = link->load();
+            if (existing != nullptr) {
+                link->store(existing->next.load());
+                retire(existing, domain.advance());
+                total_elements--;
+            }
+            reclaim();
+        }
+
+        float getLoadFactor() { return ((float) total_elements.load()) / ((float) getArraySlots()); }
+
+        int getTotalElements() { return total_elements.load(); }
+
+        int getArraySlots() {
+            EpochDomain::Guard guard(domain);
+            return (int) buckets.load()->slots;
+        }
+
+        // objects waiting for readers to move on before being freed
+        size_t getRetiredCount() {
+            lock_guard<mutex> guard(writer_lock);
+            return retiredList.size();
+        }
+
+    private:
+        struct Node {
+            size_t hashKey;
+            pair<K, V> entry;
+            atomic<Node *> next;
+
+            Node(size_t hashKey, const K &key, const V &value, Node *next)
+                : hashKey(hashKey), entry(key, value), next(next) {}
+        };
+
+        struct BucketArray {
+            size_t slots;
+            PowerOfTwoBuckets bucketPolicy;
+            unique_ptr<atomic<Node *>[]> heads;
+
+            explicit BucketArray(size_t slots)
+                : slots(slots), bucketPolicy(slots), heads(new atomic<Node *>[slots]) {
+                for (size_t i = 0; i < slots; i++)
+                    heads[i].store(nullptr);
+            }
+
+            size_t index(size_t hashKey) const { return bucketPolicy.index(hashKey); }
+        };
+
+        struct Retired {
+            uint64_t epoch;
+            void *object;
+            void (*destroy)(void *);
+        };
+
+        Hash key_hash;
+        KeyEqual key_equal;
+        atomic<BucketArray *> buckets{nullptr};
+        atomic<int> total_elements{0};
+        EpochDomain domain;
+
+        // writer-only state
+        mutex writer_lock;
+        vector<Retired> retiredList;
+
+        template <typename KeyLike>
+        size_t getHashKey(const KeyLike &key) const { return key_hash(key); }
+
+        template <typename KeyLike>
+        const Node *findNode(const KeyLike &key, size_t hashKey) const {
+            BucketArray *current = buckets.load();
+            for (Node *node = current->heads[current->index(hashKey)].load(); node != nullptr; node = node->next.load()) {
+                if (node->hashKey == hashKey && key_equal(node->entry.first, key))
+                    return node;
+            }
+            return nullptr;
+        }
+
+        // the link pointing at the key's node, or at the chain's end
+        template <typename KeyLike>
+        atomic<Node *> *findLink(BucketArray *current, const KeyLike &key, size_t hashKey) {
+            atomic<Node *> *link = &current->heads[current->index(hashKey)];
+            for (Node *node = link->load(); node != nullptr; node = link->load()) {
+                if (node->hashKey == hashKey && key_equal(node->entry.first, key))
+                    return link;
+                link = &node->next;
+            }
+            return link;
+        }
+
+        bool nextInsertReachesMaxLoad(const BucketArray *current) const {
+            return ((float) (total_elements.load() + 1)) / ((float) current->slots) >= MAX_LOAD_FACTOR;
+        }
+
+        // readers may be walking the old chains, so the new array gets
+        // copies of every node and the old array and nodes are retired
+        BucketArray *growBucketArray(BucketArray *current) {
+            BucketArray *grown = new BucketArray(current->slots * GROWTH_FACTOR);
+            for (size_t i = 0; i < current->slots; i++) {
+                for (Node *node = current->heads[i].load(); node != nullptr; node = node->next.load()) {
+                    atomic<Node *> &head = grown->heads[grown->index(node->hashKey)];
+                    head.store(new Node(node->hashKey, node->entry.first, node->entry.second, head.load()));
+                }
+            }
+            buckets.store(grown);
+
+            uint64_t epoch = domain.advance();
+            for (size_t i = 0; i < current->slots; i++) {
+                for (Node *node = current->heads[i].load(); node != nullptr; node = node->next.load())
+                    retire(node, epoch);
+            }
+            retire(current, epoch);
+            return grown;
+        }
+
+        void retire(Node *node, uint64_t epoch) {
+            retiredList.push_back(Retired{epoch, node, [](void *object) { delete static_cast<Node *>(object); }});
+        }
+
+        void retire(BucketArray *array, uint64_t epoch) {
+            retiredList.push_back(Retired{epoch, array, [](void *object) { delete static_cast<BucketArray *>(object); }});
+        }
+
+        void reclaim() {
+            if (retiredList.empty())
+                return;
+
+            uint64_t oldest = domain.oldestActiveEpoch();
+            size_t kept = 0;
+            for (Retired &retired : retiredList) {
+                if (retired.epoch < oldest)
+                    retired.destroy(retired.object);
+                else
+                    retiredList[kept++] = retired;
+            }
+            retiredList.resize(kept);
+        }
+
+        static void destroyNodes(BucketArray *array) {
+            for (size_t i = 0; i < array->slots; i++) {
+                Node *node = array->heads[i].load();
+                while (node != nullptr) {
+                    Node *next = node->next.load();
+                    delete node;
+                    node = next;
+                }
+            }
+        }
+    };
+}
+
+#endif /* readmostlyhashtable_hpp */
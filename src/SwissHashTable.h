@@ -0,0 +1,317 @@
+//
+//  SwissHashTable.h
+//
+//  This file defines an open-addressing Hash Table in the style of
+//  Abseil's flat_hash_map. Alongside the slot array it keeps one
+//  control byte per slot holding either 7 bits of the key's hash or an
+//  empty/deleted marker, and probes 16 slots at a time by comparing a
+//  whole group of control bytes with one SSE2 instruction. Most misses
+//  are settled by that compare without ever touching a key.
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef swisshashtable_hpp
+#define swisshashtable_hpp
+
+#include <utility> // for pair, move()
+#include <functional> // for hash()
+#include <optional>
+#include <memory> // allocator
+#include <cstdint>
+#include <cstring> // memset()
+#include <new> // placement new
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSI281_SWISS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h> // _BitScanForward()
+#endif
+
+#include "BucketPolicies.h"
+
+using namespace std;
+
+namespace csi281 {
+    namespace swiss {
+        // full slots hold the low 7 bits of the hash (0..127); the
+        // markers are negative so one sign-bit test finds free slots
+        constexpr int8_t EMPTY = -128;
+        constexpr int8_t DELETED = -2;
+
+        inline int lowestSetBit(uint32_t mask) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return (int) index;
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+
+        // 16 control bytes loaded at once; each match returns a bitmask
+        // with bit i set when control byte i satisfies the test
+        class Group {
+        public:
+            static constexpr size_t WIDTH = 16;
+
+#ifdef CSI281_SWISS_SSE2
+            explicit Group(const int8_t *ctrl) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl))) {}
+
+            uint32_t match(int8_t h2) const {
+                return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+            }
+
+            uint32_t matchEmpty() const { return match(EMPTY); }
+
+            uint32_t matchEmptyOrDeleted() const { return (uint32_t) _mm_movemask_epi8(ctrl); }
+
+        private:
+            __m128i ctrl;
+#else
+            explicit Group(const int8_t *ctrl) : ctrl(ctrl) {}
+
+            uint32_t match(int8_t h2) const {
+                uint32_t mask = 0;
+                for (size_t i = 0; i < WIDTH; i++) {
+                    if (ctrl[i] == h2)
+                        mask |= 1u << i;
+                }
+                return mask;
+            }
+
+            uint32_t matchEmpty() const { return match(EMPTY); }
+
+            uint32_t matchEmptyOrDeleted() const {
+                uint32_t mask = 0;
+                for (size_t i = 0; i < WIDTH; i++) {
+                    if (ctrl[i] < 0)
+                        mask |= 1u << i;
+                }
+                return mask;
+            }
+
+        private:
+            const int8_t *ctrl;
+#endif
+        };
+    }
+
+    template
+    <typename K, typename V>
+    class SwissHashTable {
+    public:
+        static constexpr int DEFAULT_SLOTS = 16;
+
+        SwissHashTable(int capacity = DEFAULT_SLOTS) {
+            if (isInvalidCapacity(capacity))
+                capacity = DEFAULT_SLOTS;
+
+            resizeHashTable(slotsFor(capacity));
+        }
+
+        SwissHashTable(const SwissHashTable &) = delete;
+        SwissHashTable &operator=(const SwissHashTable &) = delete;
+
+        ~SwissHashTable() {
+            destroySlots(ctrl, slots, array_slots);
+        }
+
+        void put(const K key, const V value) {
+            size_t hashKey = getHashKey(key);
+            size_t index = probe(key, hashKey);
+            if (index != NOT_FOUND) {
+                slots[index].second = value;
+                return;
+            }
+
+            if (growth_left == 0)
+                makeRoom();
+            insertNewEntry(hashKey, make_pair(key, value));
+        }
+
+        bool keyExists(const K &key) { return locate(key) != nullptr; }
+
+        pair<K, V> *locate(const K &key) {
+            size_t index = probe(key, getHashKey(key));
+            if (index == NOT_FOUND)
+                return nullptr;
+            return &slots[index];
+        }
+
+        optional<V> getValue(const K &key) {
+            pair<K, V> *element = locate(key);
+            if (element == nullptr)
+                return nullopt;
+            return element->second;
+        }
+
+        void removeElement(const K &key) {
+            size_t index = probe(key, getHashKey(key));
+            if (index == NOT_FOUND)
+                return;
+
+            slots[index].~pair<K, V>();
+            total_elements--;
+            // a group that still has an empty slot never made a probe
+            // move past it, so the slot can go straight back to empty
+            size_t groupStart = index & ~(swiss::Group::WIDTH - 1);
+            if (swiss::Group(ctrl + groupStart).matchEmpty() != 0) {
+                ctrl[index] = swiss::EMPTY;
+                growth_left++;
+            } else {
+                ctrl[index] = swiss::DELETED;
+            }
+        }
+
+        float getLoadFactor() { return ((float) total_elements) / ((float) array_slots); }
+
+        int getTotalElements() { return total_elements; }
+
+        int getArraySlots() { return array_slots; }
+
+        void printHashTable() {
+            for (int i = 0; i < array_slots; i++) {
+                cout << i << ":";
+                if (ctrl[i] >= 0)
+                    cout << " -> (" << slots[i].first << ", " << slots[i].second << ")";
+                cout << endl;
+            }
+        }
+
+    private:
+        static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+        int array_slots = 0;
+        int total_elements = 0;
+        // inserts left before the table must rehash; tombstones use it up too
+        int growth_left = 0;
+        size_t group_mask = 0;
+        hash<K> key_hash;
+        int8_t *ctrl = nullptr;
+        pair<K, V> *slots = nullptr;
+
+        bool isInvalidCapacity(int capacity) const { return capacity < 1; }
+
+        // whole groups, a power of two of them, kept at most 7/8 full
+        static int slotsFor(int elements) {
+            int groupsNeeded = (int) ((elements * 8 / 7 + swiss::Group::WIDTH - 1) / swiss::Group::WIDTH);
+            return (int) (PowerOfTwoBuckets::roundSlots(groupsNeeded) * swiss::Group::WIDTH);
+        }
+
+        static int maxElementsFor(int new_array_slots) { return new_array_slots / 8 * 7; }
+
+        static size_t h1(size_t hashKey) { return hashKey >> 7; }
+
+        static int8_t h2(size_t hashKey) { return (int8_t) (hashKey & 0x7f); }
+
+        // triangular probing over whole groups visits every group once
+        // when the number of groups is a power of two
+        size_t probe(const K &key, size_t hashKey) const {
+            size_t group = h1(hashKey) & group_mask;
+            for (size_t step = 1; step <= group_mask + 1; step++) {
+                size_t groupStart = group * swiss::Group::WIDTH;
+                swiss::Group controlBytes(ctrl + groupStart);
+                for (uint32_t matches = controlBytes.match(h2(hashKey)); matches != 0; matches &= matches - 1) {
+                    size_t index = groupStart + swiss::lowestSetBit(matches);
+                    if (slots[index].first == key)
+                        return index;
+                }
+                if (controlBytes.matchEmpty() != 0)
+                    return NOT_FOUND;
+                group = (group + step) & group_mask;
+            }
+            return NOT_FOUND;
+        }
+
+        size_t findFreeSlot(const int8_t *controls, size_t groups_mask, size_t hashKey) const {
+            size_t group = h1(hashKey) & groups_mask;
+            for (size_t step = 1;; step++) {
+                size_t groupStart = group * swiss::Group::WIDTH;
+                uint32_t free = swiss::Group(controls + groupStart).matchEmptyOrDeleted();
+                if (free != 0)
+                    return groupStart + swiss::lowestSetBit(free);
+                group = (group + step) & groups_mask;
+            }
+        }
+
+        void insertNewEntry(size_t hashKey, pair<K, V> &&element) {
+            size_t index = findFreeSlot(ctrl, group_mask, hashKey);
+            if (ctrl[index] == swiss::EMPTY)
+                growth_left--;
+            new (&slots[index]) pair<K, V>(move(element));
+            ctrl[index] = h2(hashKey);
+            total_elements++;
+        }
+
+        // out of room: drop tombstones in place if they are what filled
+        // the table, otherwise double the number of slots
+        void makeRoom() {
+            if (total_elements * 16 <= array_slots * 7)
+                resizeHashTable(array_slots);
+            else
+                resizeHashTable(array_slots * 2);
+        }
+
+        void resizeHashTable(int new_array_slots) {
+            int8_t *oldCtrl = ctrl;
+            pair<K, V> *oldSlots = slots;
+            int old_array_slots = array_slots;
+
+            ctrl = static_cast<int8_t *>(::operator new(new_array_slots));
+            memset(ctrl, (unsigned char) swiss::EMPTY, new_array_slots);
+            slots = allocator<pair<K, V> >().allocate(new_array_slots);
+            array_slots = new_array_slots;
+            group_mask = new_array_slots / swiss::Group::WIDTH - 1;
+            growth_left = maxElementsFor(new_array_slots) - total_elements;
+
+            for (int i = 0; i < old_array_slots; i++) {
+                if (oldCtrl[i] >= 0) {
+                    size_t hashKey = getHashKey(oldSlots[i].first);
+                    size_t index = findFreeSlot(ctrl, group_mask, hashKey);
+                    new (&slots[index]) pair<K, V>(move(oldSlots[i]));
+                    ctrl[index] = h2(hashKey);
+                }
+            }
+            destroySlots(oldCtrl, oldSlots, old_array_slots);
+        }
+
+        static void destroySlots(int8_t *controls, pair<K, V> *store, int store_slots) {
+            if (controls == nullptr)
+                return;
+
+            for (int i = 0; i < store_slots; i++) {
+                if (controls[i] >= 0)
+                    store[i].~pair<K, V>();
+            }
+            allocator<pair<K, V> >().deallocate(store, store_slots);
+            ::operator delete(controls);
+        }
+
+        size_t getHashKey(const K &key) const { return mixHash(key_hash(key)); }
+    };
+}
+
+#endif /* swisshashtable_hpp */
@@ -0,0 +1,359 @@
+//
+//  bench.cpp
+//
+//  Microbenchmarks for HashTable, measured side by side with
+//  std::unordered_map. Each operation is timed for int, short string
+//  and long string keys at 1K up to 100M elements and reported in
+//  nanoseconds per operation. Build and run it with `make bench`.
+//
+//  Usage: hashbench [max_elements]
+//  max_elements defaults to 1M; the 10M and 100M sizes need many GB of
+//  memory for string keys.
+//
+//  Usage: hashbench --latency [elements]
+//  Times every single put() while inserting elements int keys (10M by
+//  default) and reports latency percentiles plus a timeline of every
+//  resize, for HashTable with and without incremental resizing and for
+//  std::unordered_map. Averages hide resize pauses; this shows them.
+//
+//  Copyright  2024 Ryan Jackson
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation files
+//  (the "Software"), to deal in the Software without restriction,
+//  including without limitation the rights to use, copy, modify, merge,
+//  publish, distribute, sublicense, and/or sell copies of the Software,
+//  and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice
+//  shall be included in all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+//  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+//  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//  OTHER DEALINGS IN THE SOFTWARE.
+
+#include "HashTable.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace csi281;
+
+namespace {
+    using Clock = chrono::steady_clock;
+
+    constexpr size_t DEFAULT_MAX_ELEMENTS = 1000000;
+    constexpr size_t SIZES[] = {1000, 10000, 100000, 1000000, 10000000, 100000000};
+    // small sizes repeat their measurement until about this many
+    // operations have been timed, so every row is long enough to trust
+    constexpr size_t OPERATIONS_PER_MEASUREMENT = 2000000;
+
+    constexpr size_t DEFAULT_LATENCY_ELEMENTS = 10000000;
+
+    // results are folded in here so the optimizer cannot drop the work
+    volatile size_t sink = 0;
+
+    // Log-linear histogram in the style of HdrHistogram: values below
+    // 2^SUB_BUCKET_BITS are counted exactly and every power of two above
+    // that is split into 2^SUB_BUCKET_BITS equal buckets, so a reported
+    // value is within 1% of the recorded one.
+    class LatencyHistogram {
+    public:
+        void record(uint64_t nanoseconds) {
+            counts[indexFor(nanoseconds)]++;
+            total++;
+            maximum = max(maximum, nanoseconds);
+        }
+
+        // the value below which percentile percent of recordings fall
+        uint64_t percentile(double percentile) const {
+            uint64_t wanted = max((uint64_t) 1, (uint64_t) (percentile / 100.0 * (double) total + 0.5));
+            uint64_t seen = 0;
+            for (size_t index = 0; index < counts.size(); index++) {
+                seen += counts[index];
+                if (seen >= wanted)
+                    return min(highestValueAt(index), maximum);
+            }
+            return maximum;
+        }
+
+        uint64_t getMax() const { return maximum; }
+
+    private:
+        static constexpr int SUB_BUCKET_BITS = 7;
+        static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+        vector<uint64_t> counts = vector<uint64_t>(64 * SUB_BUCKETS);
+        uint64_t total = 0;
+        uint64_t maximum = 0;
+
+        static size_t indexFor(uint64_t value) {
+            if (value < SUB_BUCKETS)
+                return (size_t) value;
+            int shift = 0;
+            while ((value >> shift) >= 2 * SUB_BUCKETS)
+                shift++;
+            return (size_t) ((shift + 1) * SUB_BUCKETS + (value >> shift) - SUB_BUCKETS);
+        }
+
+        static uint64_t highestValueAt(size_t index) {
+            if (index < SUB_BUCKETS)
+                return index;
+            int shift = (int) (index / SUB_BUCKETS) - 1;
+            return ((index % SUB_BUCKETS + SUB_BUCKETS + 1) << shift) - 1;
+        }
+    };
+
+    struct ResizeEvent {
+        size_t operation;
+        size_t fromSlots;
+        size_t toSlots;
+        uint64_t nanoseconds;
+    };
+
+    struct Results {
+        double insert;
+        double lookupHit;
+        double lookupMiss;
+        double erase;
+        double iterate;
+    };
+
+    // a bijection on 32 bits, so distinct indices give distinct keys
+    uint32_t scramble(uint32_t index) {
+        index ^= index >> 16;
+        index *= 0x7feb352dU;
+        index ^= index >> 15;
+        index *= 0x846ca68bU;
+        index ^= index >> 16;
+        return index;
+    }
+
+    int intKey(size_t index) { return (int) scramble((uint32_t) index); }
+
+    // at most 8 characters, short enough for the small string buffer
+    string shortStringKey(size_t index) {
+        static const char digits[] = "0123456789abcdef";
+        string key;
+        for (uint32_t bits = scramble((uint32_t) index); bits != 0 || key.empty(); bits >>= 4)
+            key += digits[bits & 0xf];
+        return key;
+    }
+
+    // a long shared prefix makes every key comparison walk most of it
+    string longStringKey(size_t index) {
+        return "customers/north-america/accounts/active/sessions/" + shortStringKey(index);
+    }
+
+    // keys [0, count) are inserted; keys [count, 2 * count) are misses
+    template <typename K>
+    vector<K> makeKeys(size_t first, size_t count, K (*makeKey)(size_t)) {
+        vector<K> keys;
+        keys.reserve(count);
+        for (size_t index = first; index < first + count; index++)
+            keys.push_back(makeKey(index));
+        shuffle(keys.begin(), keys.end(), mt19937_64(first));
+        return keys;
+    }
+
+    template <typename K>
+    void insertKey(HashTable<K, int> &table, const K &key, int value) { table.put(key, value); }
+
+    template <typename K>
+    void insertKey(unordered_map<K, int> &table, const K &key, int value) { table.insert_or_assign(key, value); }
+
+    template <typename K>
+    bool findKey(HashTable<K, int> &table, const K &key) { return table.getValue(key).has_value(); }
+
+    template <typename K>
+    bool findKey(unordered_map<K, int> &table, const K &key) { return table.find(key) != table.end(); }
+
+    template <typename K>
+    void eraseKey(HashTable<K, int> &table, const K &key) { table.removeElement(key); }
+
+    template <typename K>
+    void eraseKey(unordered_map<K, int> &table, const K &key) { table.erase(key); }
+
+    template <typename K>
+    size_t slotCount(HashTable<K, int> &table) { return (size_t) table.getArraySlots(); }
+
+    template <typename K>
+    size_t slotCount(unordered_map<K, int> &table) { return table.bucket_count(); }
+
+    template <typename Table, typename K>
+    void fill(Table &table, const vector<K> &keys) {
+        for (size_t i = 0; i < keys.size(); i++)
+            insertKey(table, keys[i], (int) i);
+    }
+
+    double nanosecondsPerOperation(Clock::duration elapsed, size_t operations) {
+        return (double) chrono::duration_cast<chrono::nanoseconds>(elapsed).count() / (double) operations;
+    }
+
+    template <typename Table, typename K>
+    Results measure(const vector<K> &hits, const vector<K> &misses) {
+        size_t rounds = max((size_t) 1, OPERATIONS_PER_MEASUREMENT / hits.size());
+        size_t operations = rounds * hits.size();
+        Results results;
+
+        Clock::duration elapsed = Clock::duration::zero();
+        for (size_t round = 0; round < rounds; round++) {
+            Table table;
+            Clock::time_point start = Clock::now();
+            fill(table, hits);
+            elapsed += Clock::now() - start;
+        }
+        results.insert = nanosecondsPerOperation(elapsed, operations);
+
+        Table table;
+        fill(table, hits);
+        size_t found = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t round = 0; round < rounds; round++) {
+            for (const K &key : hits)
+                found += findKey(table, key);
+        }
+        results.lookupHit = nanosecondsPerOperation(Clock::now() - start, operations);
+
+        start = Clock::now();
+        for (size_t round = 0; round < rounds; round++) {
+            for (const K &key : misses)
+                found += findKey(table, key);
+        }
+        results.lookupMiss = nanosecondsPerOperation(Clock::now() - start, operations);
+
+        size_t sum = 0;
+        start = Clock::now();
+        for (size_t round = 0; round < rounds; round++) {
+            for (auto &element : table)
+                sum += (size_t) element.second;
+        }
+        results.iterate = nanosecondsPerOperation(Clock::now() - start, operations);
+
+        elapsed = Clock::duration::zero();
+        for (size_t round = 0; round < rounds; round++) {
+            Table erased;
+            fill(erased, hits);
+            start = Clock::now();
+            for (const K &key : hits)
+                eraseKey(erased, key);
+            elapsed += Clock::now() - start;
+        }
+        results.erase = nanosecondsPerOperation(elapsed, operations);
+
+        sink = sink + found + sum;
+        return results;
+    }
+
+    void printRow(const char *keyName, size_t elements, const char *operation, double hashTable, double unorderedMap) {
+        cout << left << setw(14) << keyName << right << setw(11) << elements << "  " << left << setw(13) << operation
+             << right << fixed << setprecision(1) << setw(12) << hashTable << setw(16) << unorderedMap
+             << setprecision(2) << setw(9) << hashTable / unorderedMap << endl;
+    }
+
+    template <typename K>
+    void benchmarkKeys(const char *keyName, K (*makeKey)(size_t), size_t maxElements) {
+        for (size_t elements : SIZES) {
+            if (elements > maxElements)
+                break;
+
+            vector<K> hits = makeKeys(0, elements, makeKey);
+            vector<K> misses = makeKeys(elements, elements, makeKey);
+            Results hashTable = measure<HashTable<K, int> >(hits, misses);
+            Results unorderedMap = measure<unordered_map<K, int> >(hits, misses);
+
+            printRow(keyName, elements, "insert", hashTable.insert, unorderedMap.insert);
+            printRow(keyName, elements, "lookup-hit", hashTable.lookupHit, unorderedMap.lookupHit);
+            printRow(keyName, elements, "lookup-miss", hashTable.lookupMiss, unorderedMap.lookupMiss);
+            printRow(keyName, elements, "erase", hashTable.erase, unorderedMap.erase);
+            printRow(keyName, elements, "iterate", hashTable.iterate, unorderedMap.iterate);
+        }
+    }
+
+    // times each insert on its own; a change in the slot count means
+    // that insert resized the table
+    template <typename Table>
+    void measureLatency(const char *tableName, Table &table, const vector<int> &keys) {
+        LatencyHistogram histogram;
+        vector<ResizeEvent> resizes;
+        size_t slots = slotCount(table);
+        for (size_t i = 0; i < keys.size(); i++) {
+            Clock::time_point start = Clock::now();
+            insertKey(table, keys[i], (int) i);
+            uint64_t elapsed = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+            histogram.record(elapsed);
+
+            size_t newSlots = slotCount(table);
+            if (newSlots != slots) {
+                resizes.push_back(ResizeEvent{i, slots, newSlots, elapsed});
+                slots = newSlots;
+            }
+        }
+
+        cout << left << setw(26) << tableName << right << setw(10) << histogram.percentile(50)
+             << setw(10) << histogram.percentile(99) << setw(10) << histogram.percentile(99.9)
+             << setw(12) << histogram.getMax() << endl;
+        for (const ResizeEvent &resize : resizes) {
+            cout << "    resize at insert " << setw(10) << resize.operation << ": " << setw(10) << resize.fromSlots
+                 << " -> " << setw(10) << resize.toSlots << " slots, " << setw(12) << resize.nanoseconds << " ns"
+                 << endl;
+        }
+    }
+
+    void benchmarkLatency(size_t elements) {
+        vector<int> keys = makeKeys(0, elements, intKey);
+        cout << "latency of " << elements << " int inserts in nanoseconds" << endl;
+        cout << left << setw(26) << "table" << right << setw(10) << "p50" << setw(10) << "p99" << setw(10)
+             << "p99.9" << setw(12) << "max" << endl;
+        {
+            HashTable<int, int> table;
+            measureLatency("HashTable", table, keys);
+        }
+        {
+            HashTable<int, int> table;
+            table.setIncrementalResize(true);
+            measureLatency("HashTable (incremental)", table, keys);
+        }
+        {
+            unordered_map<int, int> table;
+            measureLatency("unordered_map", table, keys);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--latency") == 0) {
+        size_t elements = DEFAULT_LATENCY_ELEMENTS;
+        if (argc > 2)
+            elements = strtoull(argv[2], nullptr, 10);
+        benchmarkLatency(elements);
+        return 0;
+    }
+
+    size_t maxElements = DEFAULT_MAX_ELEMENTS;
+    if (argc > 1)
+        maxElements = strtoull(argv[1], nullptr, 10);
+
+    cout << left << setw(14) << "keys" << right << setw(11) << "elements" << "  " << left << setw(13) << "operation"
+         << right << setw(12) << "HashTable" << setw(16) << "unordered_map" << setw(9) << "ratio" << endl;
+    cout << "(nanoseconds per operation; ratio < 1 means HashTable is faster)" << endl;
+
+    benchmarkKeys<int>("int", intKey, maxElements);
+    benchmarkKeys<string>("short-string", shortStringKey, maxElements);
+    benchmarkKeys<string>("long-string", longStringKey, maxElements);
+    return 0;
+}
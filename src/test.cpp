@@ -26,10 +26,21 @@
 //  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 //  OTHER DEALINGS IN THE SOFTWARE.
 
+// build the tests with HashTable's statistics so they are exercised too
+#define CSI281_HASHTABLE_STATS
 #include "HashTable.h"
+#include "FlatHashTable.h"
+#include "SwissHashTable.h"
+#include "ConcurrentHashTable.h"
+#include "ReadMostlyHashTable.h"
+#include "HashQuality.h"
 #include "/Users/ryanjackson/Desktop/Champlain/2024_Spring/CSI420/Final Project/RefactoringHashTables/lib/catch.h"
 #include <string>
 #include <iostream>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <vector>
 
 using namespace std;
 using namespace csi281;
@@ -38,10 +49,10 @@ TEST_CASE( "Hash Table w/ string int", "[stringint]" ) {
     SECTION( "invalid initial array_slots" ) {
         // basic checks
         HashTable<string, int> ht1 = HashTable<string, int>(0);
-        CHECK(ht1.getArraySlots() == DEFAULT_CAPACITY);
+        CHECK(ht1.getArraySlots() == HashTable<string, int>::DEFAULT_CAPACITY);
 
         HashTable<string, int> ht2 = HashTable<string, int>(-10);
-        CHECK(ht1.getArraySlots() == DEFAULT_CAPACITY);
+        CHECK(ht1.getArraySlots() == HashTable<string, int>::DEFAULT_CAPACITY);
     }
 
     SECTION( "basic string int Test" ) {
@@ -167,3 +178,1101 @@ TEST_CASE( "Hash Table w/ int float", "[intfloat]" ) {
     }
 }
 
+
+TEST_CASE( "Hash Table single probe inserts", "[singleprobe]" ) {
+    SECTION( "tryEmplace keeps an existing value" ) {
+        HashTable<string, int> ht1 = HashTable<string, int>();
+        auto result = ht1.tryEmplace("dog", 34);
+        CHECK( result.second );
+        CHECK( result.first->second == 34 );
+        result = ht1.tryEmplace("dog", 50);
+        CHECK( !result.second );
+        CHECK( result.first->second == 34 );
+        CHECK(ht1.getTotalElements() == 1 );
+    }
+
+    SECTION( "insertOrAssign overwrites and survives a resize" ) {
+        HashTable<string, int> ht1 = HashTable<string, int>(5);
+        ht1.insertOrAssign("dog", 34);
+        ht1.insertOrAssign("cat", 234);
+        ht1.insertOrAssign("panda", 134);
+        auto result = ht1.insertOrAssign("bull", 500);
+        CHECK( result.second );
+        CHECK(ht1.getArraySlots() == 10 );
+        CHECK( result.first == ht1.locate("bull") );
+        result = ht1.insertOrAssign("cat", 334);
+        CHECK( !result.second );
+        CHECK( ht1.getValue("cat").value() == 334 );
+        CHECK(ht1.getTotalElements() == 4 );
+    }
+
+    SECTION( "removing a missing key is a no-op" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        ht1.put(1, 1);
+        ht1.removeElement(2);
+        CHECK(ht1.getTotalElements() == 1 );
+    }
+}
+
+struct CopyCounter {
+    static int copies;
+    int id = 0;
+
+    CopyCounter(int id = 0) : id(id) {}
+    CopyCounter(const CopyCounter &other) : id(other.id) { copies++; }
+    CopyCounter &operator=(const CopyCounter &other) { id = other.id; copies++; return *this; }
+    CopyCounter(CopyCounter &&other) : id(other.id) {}
+    CopyCounter &operator=(CopyCounter &&other) { id = other.id; return *this; }
+};
+int CopyCounter::copies = 0;
+
+TEST_CASE( "Hash Table resize relinks nodes", "[resize]" ) {
+    SECTION( "entries keep their address and are not copied" ) {
+        HashTable<int, CopyCounter> ht1 = HashTable<int, CopyCounter>(2);
+        ht1.put(1, CopyCounter(1));
+        pair<int, CopyCounter> *first = ht1.locate(1);
+        CopyCounter::copies = 0;
+        for (int i = 2; i <= 100; i++) {
+            ht1.tryEmplace(i, i);
+        }
+        CHECK( CopyCounter::copies == 0 );
+        CHECK( ht1.getArraySlots() == 256 );
+        CHECK( ht1.locate(1) == first );
+        CHECK( ht1.getValue(77).value().id == 77 );
+    }
+}
+
+TEST_CASE( "Hash Table move-aware inserts", "[emplace]" ) {
+    SECTION( "rvalues and forwarded arguments are never copied" ) {
+        HashTable<int, CopyCounter> ht1 = HashTable<int, CopyCounter>();
+        CopyCounter::copies = 0;
+        ht1.put(1, CopyCounter(1));
+        ht1.insertOrAssign(2, CopyCounter(2));
+        ht1.insertOrAssign(2, CopyCounter(20));
+        ht1.tryEmplace(3, 3);
+        ht1.emplace(4, 4);
+        CHECK( CopyCounter::copies == 0 );
+        CHECK( ht1.getValue(2).value().id == 20 );
+        CHECK( CopyCounter::copies == 1 );
+        CHECK(ht1.getTotalElements() == 4 );
+    }
+
+    SECTION( "moved strings are taken over and duplicates are rejected" ) {
+        HashTable<string, string> ht1 = HashTable<string, string>();
+        string key = string(100, 'k');
+        string value = string(100, 'v');
+        ht1.put(move(key), move(value));
+        CHECK( ht1.getValue(string(100, 'k')).value() == string(100, 'v') );
+        auto result = ht1.emplace(string(100, 'k'), "other");
+        CHECK( !result.second );
+        CHECK( result.first->second == string(100, 'v') );
+        result = ht1.tryEmplace("short", 3, 'x');
+        CHECK( result.second );
+        CHECK( ht1.getValue("short").value() == "xxx" );
+    }
+}
+
+TEST_CASE( "Hash Table heterogeneous lookup", "[transparent]" ) {
+    SECTION( "string keys are found by string_view and const char*" ) {
+        HashTable<string, int> ht1 = HashTable<string, int>();
+        string longKey = string(64, 'z');
+        ht1.put(longKey, 1);
+        ht1.put("dog", 34);
+        // string_view does not convert to string implicitly, so these
+        // only compile through the transparent overloads
+        CHECK( ht1.getValue(string_view(longKey)).value() == 1 );
+        CHECK( ht1.keyExists(string_view("dog")) );
+        CHECK( ht1.locate(string_view("cat")) == nullptr );
+        const char *dog = "dog";
+        CHECK( ht1.getValue(dog).value() == 34 );
+        ht1.removeElement(string_view(longKey));
+        CHECK( !ht1.keyExists(longKey) );
+        CHECK(ht1.getTotalElements() == 1 );
+    }
+}
+
+struct CaseInsensitiveHash {
+    size_t operator()(const string &key) const {
+        string lowered = key;
+        transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+        return hash<string>()(lowered);
+    }
+};
+
+struct CaseInsensitiveEqual {
+    bool operator()(const string &lhs, const string &rhs) const {
+        return lhs.size() == rhs.size() && equal(lhs.begin(), lhs.end(), rhs.begin(),
+                                                 [](char a, char b) { return tolower(a) == tolower(b); });
+    }
+};
+
+struct SeededHash {
+    size_t seed = 0;
+
+    size_t operator()(int key) const { return hash<int>()(key) ^ seed; }
+};
+
+int countingAllocations = 0;
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        countingAllocations++;
+        return allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, size_t n) { allocator<T>().deallocate(p, n); }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const CountingAllocator<U> &) const { return false; }
+};
+
+TEST_CASE( "Hash Table pluggable policies", "[policies]" ) {
+    SECTION( "custom hash and key equality" ) {
+        HashTable<string, int, CaseInsensitiveHash, CaseInsensitiveEqual> ht1;
+        ht1.put("Dog", 34);
+        ht1.put("DOG", 50);
+        CHECK(ht1.getTotalElements() == 1 );
+        CHECK( ht1.getValue("dog").value() == 50 );
+    }
+
+    SECTION( "stateful hash is stored, stateless policies take no space" ) {
+        HashTable<int, int, SeededHash> ht1 = HashTable<int, int, SeededHash>(10, SeededHash{42});
+        ht1.put(1, 1);
+        CHECK( ht1.getHashFunction().seed == 42 );
+        CHECK( ht1.getValue(1).value() == 1 );
+        CHECK( sizeof(HashTable<int, int, SeededHash>) > sizeof(HashTable<int, int>) );
+    }
+
+    SECTION( "backing store and nodes come from the allocator" ) {
+        countingAllocations = 0;
+        {
+            HashTable<int, int, KeyHash<int>, equal_to<>, CountingAllocator<pair<int, int> > > ht1;
+            for (int i = 0; i < 20; i++) {
+                ht1.put(i, i);
+            }
+            CHECK( ht1.getValue(19).value() == 19 );
+        }
+        // 20 nodes plus the initial and two grown backing stores
+        CHECK( countingAllocations == 23 );
+    }
+}
+
+struct CountingHash {
+    int *calls;
+
+    size_t operator()(const string &key) const {
+        (*calls)++;
+        return hash<string>()(key);
+    }
+};
+
+TEST_CASE( "Hash Table cached hash codes", "[cachedhash]" ) {
+    SECTION( "resizes reuse the stored hash codes" ) {
+        int cachedCalls = 0;
+        int uncachedCalls = 0;
+        HashTable<string, int, CountingHash, equal_to<>, allocator<pair<string, int> >, ModuloBuckets, true>
+            cached(10, CountingHash{&cachedCalls});
+        HashTable<string, int, CountingHash> uncached(10, CountingHash{&uncachedCalls});
+        for (int i = 0; i < 100; i++) {
+            cached.put(to_string(i), i);
+            uncached.put(to_string(i), i);
+        }
+        CHECK( cachedCalls == 100 );
+        CHECK( uncachedCalls > 100 );
+        CHECK( cached.getValue("42").value() == 42 );
+    }
+
+    SECTION( "behaves like the uncached table" ) {
+        CachedHashTable<string, int> ht1 = CachedHashTable<string, int>(5);
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i < 200; i++) {
+            ht1.emplace(to_string(i), i);
+        }
+        for (int i = 0; i < 200; i += 2) {
+            ht1.removeElement(to_string(i));
+        }
+        CHECK(ht1.getTotalElements() == 100 );
+        CHECK( !ht1.keyExists("100") );
+        CHECK( ht1.getValue("101").value() == 101 );
+    }
+}
+
+TEST_CASE( "Hash Table node pool", "[pool]" ) {
+    SECTION( "nodes are recycled through the pool" ) {
+        PooledHashTable<int, string> ht1 = PooledHashTable<int, string>();
+        for (int i = 0; i < 1000; i++) {
+            ht1.put(i, to_string(i));
+        }
+        size_t slabs = ht1.getAllocator().getPool()->getSlabCount();
+        CHECK( slabs > 0 );
+        for (int i = 0; i < 1000; i++) {
+            ht1.removeElement(i);
+        }
+        for (int i = 1000; i < 2000; i++) {
+            ht1.put(i, to_string(i));
+        }
+        CHECK( ht1.getAllocator().getPool()->getSlabCount() == slabs );
+        CHECK( ht1.getValue(1500).value() == "1500" );
+        CHECK( !ht1.getValue(500).has_value() );
+    }
+
+    SECTION( "each table owns its own pool" ) {
+        PooledHashTable<int, int> ht1;
+        PooledHashTable<int, int> ht2;
+        CHECK( ht1.getAllocator() != ht2.getAllocator() );
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i < 100; i++) {
+            ht1.emplace(i, i);
+        }
+        CHECK(ht1.getTotalElements() == 100 );
+        CHECK( ht1.getValue(99).value() == 99 );
+    }
+
+    SECTION( "finishing an incremental resize releases the old buckets" ) {
+        PooledHashTable<int, int> ht1(1000);
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i <= 700; i++) {
+            ht1.put(i, i);
+        }
+        CHECK( ht1.isRehashing() );
+        ht1.setIncrementalResize(false);
+        CHECK( !ht1.isRehashing() );
+        CHECK( ht1.getValue(700).value() == 700 );
+    }
+
+    SECTION( "allocator copies are one pointer sharing the pool" ) {
+        CHECK( sizeof(PoolAllocator<int>) == sizeof(void *) );
+        PoolAllocator<int> allocator1;
+        PoolAllocator<string> allocator2(allocator1);
+        {
+            PoolAllocator<int> allocator3;
+            allocator3 = allocator1;
+            CHECK( allocator3 == allocator2 );
+        }
+        string *element = allocator2.allocate(1);
+        CHECK( allocator1.getPool()->getLiveBytes() >= sizeof(string) );
+        allocator2.deallocate(element, 1);
+        CHECK( allocator1.getPool()->getLiveBytes() == 0 );
+    }
+}
+
+TEST_CASE( "Hash Table iterators", "[iterators]" ) {
+    SECTION( "range-for and algorithms visit every entry once" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        CHECK( ht1.begin() == ht1.end() );
+        for (int i = 0; i < 50; i++) {
+            ht1.put(i, i * 2);
+        }
+        int sum = 0;
+        for (pair<int, int> &element : ht1) {
+            element.second++;
+            sum += element.first;
+        }
+        CHECK( sum == 1225 );
+        CHECK( distance(ht1.begin(), ht1.end()) == 50 );
+        CHECK( ht1.getValue(10).value() == 21 );
+        auto found = find_if(ht1.begin(), ht1.end(), [](const pair<int, int> &element) { return element.second == 99; });
+        REQUIRE( found != ht1.cend() );
+        CHECK( found->first == 49 );
+    }
+
+    SECTION( "const iteration covers both stores while rehashing" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>(10);
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i < 60; i++) {
+            ht1.put(i, i);
+        }
+        REQUIRE( ht1.isRehashing() );
+        const HashTable<int, int> &view = ht1;
+        vector<int> keys;
+        for (const pair<int, int> &element : view) {
+            keys.push_back(element.first);
+        }
+        sort(keys.begin(), keys.end());
+        CHECK( keys.size() == 60 );
+        CHECK( keys.front() == 0 );
+        CHECK( keys.back() == 59 );
+        CHECK( adjacent_find(keys.begin(), keys.end()) == keys.end() );
+    }
+}
+
+TEST_CASE( "Hash Table statistics", "[stats]" ) {
+    SECTION( "counts operations, chain walks and resizes" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>(10);
+        ht1.setMinLoadFactor(0);
+        for (int i = 0; i < 20; i++) {
+            ht1.put(i, i);
+        }
+        ht1.put(5, 50);
+        CHECK( ht1.getValue(5).value() == 50 );
+        CHECK( !ht1.keyExists(100) );
+        ht1.removeElement(0);
+        ht1.removeElement(100);
+
+        HashTableStats stats = ht1.getStats();
+        CHECK( stats.inserts == 20 );
+        CHECK( stats.erases == 1 );
+        CHECK( stats.lookups == 25 );
+        CHECK( stats.resizes == 2 );
+        CHECK( stats.longestWalk >= 1 );
+        CHECK( stats.averageWalk() > 0 );
+        size_t buckets = 0;
+        size_t entries = 0;
+        for (size_t n = 0; n < stats.bucketOccupancy.size(); n++) {
+            buckets += stats.bucketOccupancy[n];
+            entries += n * stats.bucketOccupancy[n];
+        }
+        CHECK( buckets == 40 );
+        CHECK( entries == 19 );
+        CHECK( stats.toJson().find("\"inserts\": 20,") != string::npos );
+
+        ht1.resetStats();
+        CHECK( ht1.getStats().lookups == 0 );
+        ht1.removeElement(1);
+        CHECK( ht1.getStats().lookups == 1 );
+        CHECK( ht1.getStats().nodesWalked >= 1 );
+    }
+}
+
+TEST_CASE( "Hash Table memory usage", "[memory]" ) {
+    SECTION( "bucket array, entries and node overhead" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>(10);
+        for (int i = 0; i < 100; i++) {
+            ht1.put(i, i);
+        }
+        HashTableMemoryUsage usage = ht1.memoryUsage();
+        CHECK( usage.bucketArray == ht1.getArraySlots() * sizeof(list<pair<int, int> >) );
+        CHECK( usage.entries == 100 * sizeof(pair<int, int>) );
+        CHECK( usage.nodeOverhead >= 100 * 2 * sizeof(void *) );
+        CHECK( usage.slack == 0 );
+        CHECK( usage.ownedHeap == 0 );
+        CHECK( usage.total() > 5 * usage.entries );
+    }
+
+    SECTION( "heap owned by keys and values" ) {
+        HashTable<int, string> ht1 = HashTable<int, string>(10);
+        ht1.put(1, "short");
+        ht1.put(2, string(1000, 'x'));
+        CHECK( ht1.memoryUsage().ownedHeap == 0 );
+        CHECK( ht1.memoryUsage(true).ownedHeap >= 1001 );
+        CHECK( ht1.memoryUsage(true).ownedHeap < 1100 );
+    }
+
+    SECTION( "free nodes held by a pool are slack" ) {
+        PooledHashTable<int, int> ht1;
+        for (int i = 0; i < 100; i++) {
+            ht1.put(i, i);
+        }
+        size_t slack = ht1.memoryUsage().slack;
+        for (int i = 0; i < 50; i++) {
+            ht1.removeElement(i);
+        }
+        CHECK( ht1.memoryUsage().slack > slack );
+    }
+
+    SECTION( "pool block rounding is node overhead" ) {
+        PooledHashTable<int, int> ht1;
+        for (int i = 0; i < 64; i++) {
+            ht1.put(i, i);
+        }
+        HashTableMemoryUsage usage = ht1.memoryUsage();
+        const NodePool &pool = *ht1.getAllocator().getPool();
+        CHECK( usage.entries + usage.nodeOverhead == pool.getLiveBytes() );
+        CHECK( usage.entries + usage.nodeOverhead + usage.slack == pool.getReservedBytes() );
+    }
+}
+
+TEST_CASE( "Hash Table batched lookups", "[getmany]" ) {
+    SECTION( "getMany agrees with getValue for hits and misses" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        ht1.setIncrementalResize(true);
+        vector<int> keys;
+        for (int i = 0; i < 1000; i++) {
+            ht1.put(i * 3, i);
+            keys.push_back(i * 2);
+        }
+        vector<optional<int> > values = ht1.getMany(keys);
+        REQUIRE( values.size() == keys.size() );
+        bool allMatch = true;
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (values[i] != ht1.getValue(keys[i]))
+                allMatch = false;
+        }
+        CHECK( allMatch );
+        CHECK( values[3].value() == 2 );
+        CHECK( !values[1].has_value() );
+    }
+}
+
+TEST_CASE( "Hash Table bulk load", "[putmany]" ) {
+    SECTION( "range constructor sizes the table once" ) {
+        vector<pair<int, int> > pairs;
+        for (int i = 0; i < 1000; i++) {
+            pairs.emplace_back(i, i * i);
+        }
+        HashTable<int, int> ht1(pairs.begin(), pairs.end());
+        CHECK(ht1.getTotalElements() == 1000 );
+        CHECK(ht1.getArraySlots() == 1429 );
+        CHECK( ht1.getLoadFactor() < 0.7f );
+        CHECK( ht1.getValue(999).value() == 999 * 999 );
+    }
+
+    SECTION( "putMany overwrites keys still waiting in the old store" ) {
+        HashTable<int, int> ht1(100);
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i <= 70; i++) {
+            ht1.put(i, i);
+        }
+        CHECK( ht1.isRehashing() );
+        vector<pair<int, int> > pairs;
+        for (int i = 0; i < 10; i++) {
+            pairs.emplace_back(i, -i);
+        }
+        ht1.putMany(pairs.begin(), pairs.end());
+        CHECK(ht1.getTotalElements() == 71 );
+        CHECK( ht1.getValue(5).value() == -5 );
+        int visited = 0;
+        for (const pair<int, int> &element : ht1) {
+            visited++;
+            if (element.first < 10)
+                CHECK( element.second == -element.first );
+        }
+        CHECK( visited == 71 );
+    }
+
+    SECTION( "putMany overwrites duplicates and keeps existing entries" ) {
+        HashTable<string, int> ht1 = HashTable<string, int>();
+        ht1.put("dog", 1);
+        unordered_map<string, int> more = {{"cat", 2}, {"dog", 3}, {"bull", 4}};
+        ht1.putMany(more.begin(), more.end());
+        vector<pair<string, int> > again = {{"cat", 5}, {"cat", 6}};
+        ht1.putMany(again.begin(), again.end());
+        CHECK(ht1.getTotalElements() == 3 );
+        CHECK( ht1.getValue("dog").value() == 3 );
+        CHECK( ht1.getValue("cat").value() == 6 );
+        CHECK(ht1.getArraySlots() == 10 );
+    }
+}
+
+TEST_CASE( "Hash Table capacity management", "[capacity]" ) {
+    SECTION( "reserve pre-sizes so later puts never resize" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        ht1.reserve(1000);
+        int reserved = ht1.getArraySlots();
+        CHECK( reserved == 1429 );
+        for (int i = 0; i < 1000; i++) {
+            ht1.put(i, i);
+        }
+        CHECK(ht1.getArraySlots() == reserved );
+        ht1.reserve(10);
+        CHECK(ht1.getArraySlots() == reserved );
+    }
+
+    SECTION( "removals do not undo reserve or rehash" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        ht1.reserve(1000);
+        ht1.put(1, 1);
+        ht1.removeElement(1);
+        CHECK(ht1.getArraySlots() == 1429 );
+
+        HashTable<int, int> ht2 = HashTable<int, int>();
+        ht2.rehash(5000);
+        ht2.put(1, 1);
+        ht2.put(2, 2);
+        ht2.removeElement(1);
+        CHECK(ht2.getArraySlots() == 5000 );
+        // shrinkToFit hands the slots back and lets removals shrink again
+        ht2.shrinkToFit();
+        CHECK(ht2.getArraySlots() == 2 );
+    }
+
+    SECTION( "rehash and shrinkToFit rebuild the backing store" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i < 1000; i++) {
+            ht1.put(i, i);
+        }
+        ht1.rehash(5000);
+        CHECK(ht1.getArraySlots() == 5000 );
+        CHECK( !ht1.isRehashing() );
+        // cannot go below what the current elements need
+        ht1.rehash(10);
+        CHECK(ht1.getArraySlots() == 1429 );
+        for (int i = 10; i < 1000; i++) {
+            ht1.removeElement(i);
+        }
+        ht1.shrinkToFit();
+        CHECK(ht1.getArraySlots() == 15 );
+        bool allFound = true;
+        for (int i = 0; i < 10; i++) {
+            if (ht1.getValue(i) != optional<int>(i))
+                allFound = false;
+        }
+        CHECK( allFound );
+    }
+}
+
+TEST_CASE( "Hash Table automatic shrinking", "[shrink]" ) {
+    SECTION( "halves when the load drops below the minimum" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        for (int i = 0; i < 1000; i++) {
+            ht1.put(i, i);
+        }
+        CHECK(ht1.getArraySlots() == 2560 );
+        for (int i = 5; i < 1000; i++) {
+            ht1.removeElement(i);
+        }
+        CHECK(ht1.getArraySlots() == 40 );
+        // oscillating around the threshold does not resize
+        for (int round = 0; round < 10; round++) {
+            ht1.removeElement(4);
+            ht1.put(4, 4);
+        }
+        CHECK(ht1.getArraySlots() == 40 );
+        ht1.removeElement(4);
+        ht1.removeElement(3);
+        CHECK(ht1.getArraySlots() == 20 );
+        CHECK( ht1.getValue(0).value() == 0 );
+    }
+
+    SECTION( "rounded minimum sizes are not rebuilt in place" ) {
+        using PowerOfTwoTable = HashTable<int, int, KeyHash<int>, equal_to<>, allocator<pair<int, int> >,
+                                          PowerOfTwoBuckets>;
+        using FastModTable = HashTable<int, int, KeyHash<int>, equal_to<>, allocator<pair<int, int> >,
+                                       FastModBuckets>;
+        PowerOfTwoTable ht1 = PowerOfTwoTable(1000);
+        FastModTable ht2 = FastModTable(10);
+        CHECK(ht1.getArraySlots() == 1024 );
+        CHECK(ht2.getArraySlots() == 11 );
+        ht1.resetStats();
+        ht2.resetStats();
+        for (int i = 0; i < 100; i++) {
+            ht1.put(i, i);
+            ht1.removeElement(i);
+            ht2.put(i, i);
+            ht2.removeElement(i);
+        }
+        CHECK(ht1.getStats().resizes == 0 );
+        CHECK(ht2.getStats().resizes == 0 );
+        CHECK(ht1.getArraySlots() == 1024 );
+        CHECK(ht2.getArraySlots() == 11 );
+    }
+
+    SECTION( "a minimum of zero never shrinks" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        ht1.setMinLoadFactor(0);
+        for (int i = 0; i < 100; i++) {
+            ht1.put(i, i);
+        }
+        for (int i = 0; i < 100; i++) {
+            ht1.removeElement(i);
+        }
+        CHECK(ht1.getArraySlots() == 160 );
+        ht1.setMinLoadFactor(1.0f);
+        CHECK( ht1.getMinLoadFactor() == ht1.getMaxLoadFactor() / 4 );
+    }
+}
+
+TEST_CASE( "Hash Table per-instance tuning", "[tuning]" ) {
+    SECTION( "growth factor and max load factor are per table" ) {
+        HashTable<int, int> dense = HashTable<int, int>(10);
+        HashTable<int, int> sparse = HashTable<int, int>(10);
+        dense.setMaxLoadFactor(4.0f);
+        dense.setGrowthFactor(1.5f);
+        sparse.setMaxLoadFactor(0.25f);
+        for (int i = 0; i < 100; i++) {
+            dense.put(i, i);
+            sparse.put(i, i);
+        }
+        CHECK( dense.getLoadFactor() < 4.0f );
+        CHECK( dense.getLoadFactor() >= 4.0f / 1.5f );
+        CHECK( sparse.getLoadFactor() < 0.25f );
+        CHECK(sparse.getArraySlots() == 640 );
+    }
+
+    SECTION( "a large growth factor does not thrash at the threshold" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>(10);
+        ht1.setGrowthFactor(8);
+        CHECK( ht1.getMinLoadFactor() == 0.7f / 64 );
+        for (int i = 0; i < 8; i++) {
+            ht1.put(i, i);
+        }
+        CHECK(ht1.getArraySlots() == 80 );
+        ht1.resetStats();
+        for (int round = 0; round < 10; round++) {
+            ht1.removeElement(7);
+            ht1.put(7, 7);
+        }
+        CHECK(ht1.getStats().resizes == 0 );
+        CHECK(ht1.getArraySlots() == 80 );
+    }
+
+    SECTION( "the requested min load factor survives a temporary cap" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>();
+        ht1.setMaxLoadFactor(0.25f);
+        CHECK( ht1.getMinLoadFactor() == 0.25f / 4 );
+        ht1.setMaxLoadFactor(0.7f);
+        CHECK( ht1.getMinLoadFactor() == 0.1f );
+        ht1.setGrowthFactor(8);
+        ht1.setGrowthFactor(2);
+        CHECK( ht1.getMinLoadFactor() == 0.1f );
+    }
+
+    SECTION( "lowering the max load factor rebuilds the backing store" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>(10);
+        for (int i = 0; i < 100; i++) {
+            ht1.put(i, i);
+        }
+        CHECK( ht1.getLoadFactor() >= 0.25f );
+        ht1.setMaxLoadFactor(0.25f);
+        CHECK( ht1.getLoadFactor() < 0.25f );
+        CHECK( ht1.getValue(99).value() == 99 );
+        ht1.setMaxLoadFactor(-1);
+        CHECK( ht1.getMaxLoadFactor() == (float) HashTable<int, int>::DEFAULT_MAX_LOAD_FACTOR );
+    }
+}
+
+TEST_CASE( "Hash Table incremental resize", "[incremental]" ) {
+    SECTION( "old and new backing stores are both searched while migrating" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>(100);
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i < 70; i++) {
+            ht1.put(i, i);
+        }
+        CHECK( !ht1.isRehashing() );
+        ht1.put(70, 70);
+        CHECK( ht1.isRehashing() );
+        CHECK(ht1.getArraySlots() == 200 );
+        bool allFound = true;
+        for (int i = 0; i <= 70; i++) {
+            if (ht1.getValue(i) != optional<int>(i))
+                allFound = false;
+        }
+        CHECK( allFound );
+        CHECK( !ht1.isRehashing() );
+    }
+
+    SECTION( "a large new store is built a few buckets per call" ) {
+        PooledHashTable<int, int> ht1(1000);
+        ht1.setIncrementalResize(true);
+        for (int i = 0; i <= 700; i++) {
+            ht1.put(i, i);
+        }
+        // still inserting into the old store while the new one is built
+        CHECK( ht1.isRehashing() );
+        CHECK(ht1.getArraySlots() == 1000 );
+        ht1.put(701, 701);
+        CHECK(ht1.getArraySlots() == 1000 );
+        CHECK( ht1.memoryUsage().bucketArray > 2000 * sizeof(list<pair<int, int> >) );
+        for (int i = 0; i < 7; i++) {
+            ht1.getValue(i);
+        }
+        CHECK(ht1.getArraySlots() == 2000 );
+        bool allFound = true;
+        for (int i = 0; i <= 701; i++) {
+            if (ht1.getValue(i) != optional<int>(i))
+                allFound = false;
+        }
+        CHECK( allFound );
+        CHECK( !ht1.isRehashing() );
+        CHECK(ht1.getStats().resizes == 1 );
+
+        // a table destroyed mid-build releases the partly built store
+        PooledHashTable<int, int> ht2(1000);
+        ht2.setIncrementalResize(true);
+        for (int i = 0; i <= 700; i++) {
+            ht2.put(i, i);
+        }
+        CHECK( ht2.isRehashing() );
+    }
+
+    SECTION( "matches std::unordered_map across many resizes" ) {
+        HashTable<int, int> ht1 = HashTable<int, int>(1);
+        ht1.setIncrementalResize(true);
+        unordered_map<int, int> reference;
+        for (int i = 0; i < 20000; i++) {
+            int key = (i * 7919) % 6007;
+            if (i % 4 == 0) {
+                ht1.removeElement(key);
+                reference.erase(key);
+            } else {
+                ht1.put(key, i);
+                reference[key] = i;
+            }
+        }
+        CHECK(ht1.getTotalElements() == (int) reference.size() );
+        bool allMatch = true;
+        for (int key = 0; key < 6007; key++) {
+            auto found = reference.find(key);
+            optional<int> expected = found == reference.end() ? nullopt : optional<int>(found->second);
+            if (ht1.getValue(key) != expected)
+                allMatch = false;
+        }
+        CHECK( allMatch );
+    }
+}
+
+TEST_CASE( "Hash Table bucket policies", "[bucketpolicy]" ) {
+    SECTION( "power of two slots with masked buckets" ) {
+        using PowerOfTwoTable = HashTable<int, float, KeyHash<int>, equal_to<>, allocator<pair<int, float> >,
+                                          PowerOfTwoBuckets>;
+        PowerOfTwoTable ht1 = PowerOfTwoTable(10);
+        CHECK(ht1.getArraySlots() == 16 );
+        for (int i = 1; i <= 50; i++) {
+            ht1.put(i * 1024, ((float) i) / 3.0f);
+        }
+        CHECK(ht1.getTotalElements() == 50 );
+        CHECK(ht1.getArraySlots() == 128 );
+        for (int i = 1; i <= 50; i++) {
+            CHECK( ht1.getValue(i * 1024).has_value() );
+        }
+        ht1.removeElement(2048);
+        CHECK( !ht1.getValue(2048).has_value() );
+        CHECK(ht1.getTotalElements() == 49 );
+    }
+
+    SECTION( "mixed hashes spread strided keys over every bucket" ) {
+        PowerOfTwoBuckets buckets = PowerOfTwoBuckets(64);
+        bool seen[64] = {};
+        for (size_t i = 0; i < 1024; i++) {
+            seen[buckets.index(hash<size_t>()(i * 64))] = true;
+        }
+        CHECK( count(begin(seen), end(seen), true) == 64 );
+    }
+
+    SECTION( "prime slots with fastmod buckets" ) {
+        using FastModTable = HashTable<int, float, KeyHash<int>, equal_to<>, allocator<pair<int, float> >,
+                                       FastModBuckets>;
+        FastModTable ht1 = FastModTable(10);
+        CHECK(ht1.getArraySlots() == 11 );
+        for (int i = 1; i <= 50; i++) {
+            ht1.put(i, ((float) i) / 3.0f);
+        }
+        CHECK(ht1.getTotalElements() == 50 );
+        CHECK(ht1.getArraySlots() == 97 );
+        for (int i = 1; i <= 50; i++) {
+            CHECK( ht1.getValue(i).has_value() );
+        }
+    }
+
+    SECTION( "fastmod agrees with modulo" ) {
+        bool allMatch = true;
+        for (size_t slots : {2, 11, 89, 65521, 1000003}) {
+            FastModBuckets buckets = FastModBuckets(slots);
+            for (uint64_t h = 0; h < 100000; h += 7) {
+                uint64_t hashKey = h * 0x9e3779b97f4a7c15ULL;
+                uint32_t folded = (uint32_t) (hashKey ^ (hashKey >> 32));
+                if (buckets.index((size_t) hashKey) != folded % slots)
+                    allMatch = false;
+            }
+        }
+        CHECK( allMatch );
+    }
+}
+
+TEST_CASE( "Flat Hash Table", "[flat]" ) {
+    SECTION( "basic string int Test" ) {
+        FlatHashTable<string, int> ht1 = FlatHashTable<string, int>();
+        ht1.put("dog", 34);
+        auto optValue = ht1.getValue("dog");
+        CHECK( optValue.has_value() );
+        CHECK( optValue.value() == 34 );
+        CHECK(ht1.getTotalElements() == 1 );
+        // change value
+        ht1.put("dog", 50);
+        optValue = ht1.getValue("dog");
+        CHECK( optValue.value() == 50 );
+        CHECK(ht1.getTotalElements() == 1 );
+        // removeElement value
+        ht1.removeElement("dog");
+        optValue = ht1.getValue("dog");
+        CHECK(ht1.getTotalElements() == 0 );
+        CHECK( !optValue.has_value() );
+    }
+
+    SECTION( "slots are rounded to a power of two and grow" ) {
+        FlatHashTable<int, float> ht1 = FlatHashTable<int, float>(10);
+        CHECK(ht1.getArraySlots() == 16 );
+        for (int i = 1; i <= 50; i++) {
+            ht1.put(i, ((float) i) / 3.0f);
+        }
+        CHECK(ht1.getTotalElements() == 50 );
+        CHECK(ht1.getArraySlots() == 64 );
+        CHECK(ht1.getLoadFactor() <= FlatHashTable<int, float>::MAX_LOAD );
+        for (int i = 1; i <= 50; i++) {
+            CHECK( ht1.getValue(i).has_value() );
+        }
+        CHECK( !ht1.getValue(51).has_value() );
+    }
+
+    SECTION( "matches std::unordered_map under mixed puts and removes" ) {
+        FlatHashTable<int, int> ht1 = FlatHashTable<int, int>(1);
+        unordered_map<int, int> reference;
+        for (int i = 0; i < 5000; i++) {
+            int key = (i * 7919) % 1013;
+            if (i % 3 == 0) {
+                ht1.removeElement(key);
+                reference.erase(key);
+            } else {
+                ht1.put(key, i);
+                reference[key] = i;
+            }
+        }
+        CHECK(ht1.getTotalElements() == (int) reference.size() );
+        bool allMatch = true;
+        for (int key = 0; key < 1013; key++) {
+            auto optValue = ht1.getValue(key);
+            auto found = reference.find(key);
+            if (optValue.has_value() != (found != reference.end()) ||
+                (optValue.has_value() && optValue.value() != found->second))
+                allMatch = false;
+        }
+        CHECK( allMatch );
+    }
+}
+
+TEST_CASE( "Swiss Hash Table", "[swiss]" ) {
+    SECTION( "basic string int Test" ) {
+        SwissHashTable<string, int> ht1 = SwissHashTable<string, int>();
+        ht1.put("dog", 34);
+        CHECK( ht1.getValue("dog").value() == 34 );
+        ht1.put("dog", 50);
+        CHECK( ht1.getValue("dog").value() == 50 );
+        CHECK(ht1.getTotalElements() == 1 );
+        ht1.removeElement("dog");
+        CHECK( !ht1.getValue("dog").has_value() );
+        CHECK(ht1.getTotalElements() == 0 );
+    }
+
+    SECTION( "slots are whole groups and grow at 7/8 full" ) {
+        SwissHashTable<int, float> ht1 = SwissHashTable<int, float>(1);
+        CHECK(ht1.getArraySlots() == 16 );
+        for (int i = 1; i <= 50; i++) {
+            ht1.put(i, ((float) i) / 3.0f);
+        }
+        CHECK(ht1.getTotalElements() == 50 );
+        CHECK(ht1.getArraySlots() == 64 );
+        CHECK( ht1.getLoadFactor() <= 0.875f );
+        for (int i = 1; i <= 50; i++) {
+            CHECK( ht1.getValue(i).has_value() );
+        }
+    }
+
+    SECTION( "matches std::unordered_map under churn that leaves tombstones" ) {
+        SwissHashTable<int, int> ht1 = SwissHashTable<int, int>(1);
+        unordered_map<int, int> reference;
+        for (int i = 0; i < 50000; i++) {
+            int key = (i * 7919) % 3001;
+            if (i % 2 == 0) {
+                ht1.removeElement(key);
+                reference.erase(key);
+            } else {
+                ht1.put(key, i);
+                reference[key] = i;
+            }
+        }
+        CHECK(ht1.getTotalElements() == (int) reference.size() );
+        bool allMatch = true;
+        for (int key = 0; key < 3001; key++) {
+            auto found = reference.find(key);
+            optional<int> expected = found == reference.end() ? nullopt : optional<int>(found->second);
+            if (ht1.getValue(key) != expected)
+                allMatch = false;
+        }
+        CHECK( allMatch );
+    }
+}
+
+TEST_CASE( "Concurrent Hash Table", "[concurrent]" ) {
+    SECTION( "shard count is rounded to a power of two" ) {
+        ConcurrentHashTable<string, int> ht1 = ConcurrentHashTable<string, int>(10);
+        CHECK( ht1.getShardCount() == 16 );
+        ht1.put("dog", 34);
+        CHECK( ht1.getValue("dog").value() == 34 );
+        CHECK( !ht1.tryEmplace("dog", 50) );
+        ht1.removeElement("dog");
+        CHECK( !ht1.keyExists("dog") );
+    }
+
+    SECTION( "parallel writers and readers" ) {
+        ConcurrentHashTable<int, int> ht1 = ConcurrentHashTable<int, int>(8);
+        const int threadCount = 4;
+        const int perThread = 5000;
+        vector<thread> workers;
+        for (int t = 0; t < threadCount; t++) {
+            workers.emplace_back([&ht1, t, perThread]() {
+                for (int i = t * perThread; i < (t + 1) * perThread; i++) {
+                    ht1.put(i, i * 2);
+                    ht1.getValue(i / 2);
+                }
+                for (int i = t * perThread; i < (t + 1) * perThread; i += 2) {
+                    ht1.removeElement(i);
+                }
+            });
+        }
+        for (thread &worker : workers) {
+            worker.join();
+        }
+        CHECK(ht1.getTotalElements() == threadCount * perThread / 2 );
+        bool allMatch = true;
+        for (int i = 0; i < threadCount * perThread; i++) {
+            optional<int> expected = i % 2 == 0 ? nullopt : optional<int>(i * 2);
+            if (ht1.getValue(i) != expected)
+                allMatch = false;
+        }
+        CHECK( allMatch );
+    }
+}
+
+TEST_CASE( "Read Mostly Hash Table", "[readmostly]" ) {
+    SECTION( "basic string int Test" ) {
+        ReadMostlyHashTable<string, int> ht1 = ReadMostlyHashTable<string, int>(5);
+        ht1.put("dog", 34);
+        ht1.put("cat", 234);
+        ht1.put("panda", 134);
+        ht1.put("dog", 50);
+        CHECK( ht1.getValue("dog").value() == 50 );
+        CHECK(ht1.getTotalElements() == 3 );
+        CHECK(ht1.getArraySlots() == 8 );
+        ht1.put("bull", 500);
+        ht1.put("cow", 5);
+        ht1.put("hen", 6);
+        CHECK(ht1.getArraySlots() == 16 );
+        ht1.removeElement("cat");
+        CHECK( !ht1.keyExists("cat") );
+        CHECK( ht1.getValue("bull").value() == 500 );
+        CHECK(ht1.getTotalElements() == 5 );
+        // nothing is reading, so every retired node has been freed
+        CHECK( ht1.getRetiredCount() == 0 );
+    }
+
+    SECTION( "readers see whole pairs while a writer updates, removes and grows" ) {
+        ReadMostlyHashTable<int, string> ht1 = ReadMostlyHashTable<int, string>(1);
+        atomic<bool> done(false);
+        atomic<bool> torn(false);
+        vector<thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.emplace_back([&ht1, &done, &torn]() {
+                while (!done.load()) {
+                    for (int key = 0; key < 500; key++) {
+                        optional<string> value = ht1.getValue(key);
+                        if (value.has_value() && value.value().compare(0, to_string(key).size() + 1, to_string(key) + ":") != 0)
+                            torn = true;
+                    }
+                }
+            });
+        }
+        for (int round = 0; round < 20; round++) {
+            for (int key = 0; key < 500; key++) {
+                ht1.put(key, to_string(key) + ":" + to_string(round));
+            }
+            for (int key = round % 2; key < 500; key += 2) {
+                ht1.removeElement(key);
+            }
+        }
+        done = true;
+        for (thread &reader : readers) {
+            reader.join();
+        }
+        CHECK( !torn );
+        CHECK(ht1.getTotalElements() == 250 );
+        CHECK( ht1.getValue(0).value() == "0:19" );
+        CHECK( !ht1.keyExists(1) );
+    }
+}
+
+struct LengthHash {
+    size_t operator()(const string &key) const { return key.size(); }
+};
+
+struct Point {
+    int x;
+    int y;
+};
+
+struct PointHash {
+    size_t operator()(const Point &point) const { return hash<int>()(point.x) ^ hash<int>()(point.y); }
+};
+
+enum class Color { Red, Green };
+
+struct PaddedKey {
+    char c;
+    int x;
+};
+
+struct PaddedKeyHash {
+    size_t operator()(const PaddedKey &key) const { return hash<int>()(key.c) * 31 + hash<int>()(key.x); }
+};
+
+TEST_CASE( "Hash quality analyzer", "[quality]" ) {
+    vector<string> keys;
+    for (int i = 0; i < 5000; i++) {
+        keys.push_back("key" + to_string(i));
+    }
+
+    SECTION( "a good hash spreads keys evenly" ) {
+        HashQualityReport report = analyzeHash(keys, 1000);
+        CHECK(report.keys == 5000 );
+        CHECK(report.buckets == 1000 );
+        CHECK( report.normalizedChiSquared < 1.5 );
+        CHECK( report.collisionRate == 0 );
+        REQUIRE( report.hasAvalanche );
+        CHECK( report.avalanche > 0.4 );
+        CHECK( report.avalanche < 0.6 );
+    }
+
+    SECTION( "a bad hash is caught" ) {
+        HashQualityReport report = analyzeHash(keys, 1000, LengthHash());
+        CHECK( report.normalizedChiSquared > 100 );
+        CHECK( report.longestChain >= 4000 );
+        CHECK( report.collisionRate > 0.99 );
+        CHECK( report.avalanche == 0 );
+
+        // both keys of a colliding pair count
+        HashQualityReport pairReport = analyzeHash(vector<string>{"a", "b", "cc"}, 10, LengthHash());
+        CHECK( pairReport.collisionRate == 2.0 / 3.0 );
+    }
+
+    SECTION( "struct keys and whole tables" ) {
+        vector<Point> points;
+        for (int x = 0; x < 50; x++) {
+            for (int y = 0; y < 50; y++) {
+                points.push_back(Point{x, y});
+            }
+        }
+        HashQualityReport report = analyzeHash<PowerOfTwoBuckets>(points, 1024, PointHash());
+        CHECK(report.buckets == 1024 );
+        CHECK( report.collisionRate > 0.9 );
+        CHECK( report.avalanche < 0.1 );
+
+        CHECK( report.hasAvalanche );
+
+        // padding bytes are not part of the key, so they are never flipped
+        vector<PaddedKey> paddedKeys;
+        for (int i = 0; i < 1000; i++) {
+            paddedKeys.push_back(PaddedKey{(char) (i % 128), i});
+        }
+        HashQualityReport paddedReport = analyzeHash(paddedKeys, 1000, PaddedKeyHash());
+        CHECK(paddedReport.keys == 1000 );
+        CHECK( !paddedReport.hasAvalanche );
+        CHECK( !analyzeHash(vector<Color>{Color::Red, Color::Green}, 10).hasAvalanche );
+
+        HashTable<string, int> ht1 = HashTable<string, int>(10);
+        for (int i = 0; i < 1000; i++) {
+            ht1.put(keys[i], i);
+        }
+        HashQualityReport tableReport = analyzeHash(ht1);
+        CHECK(tableReport.keys == 1000 );
+        CHECK(tableReport.buckets == (size_t) ht1.getArraySlots() );
+        CHECK( tableReport.longestChain < 10 );
+    }
+}